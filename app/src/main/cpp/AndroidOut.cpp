@@ -1,4 +1,5 @@
 #include "AndroidOut.h"
 
-AndroidOut androidOut("AO");
-std::ostream aout(&androidOut);
\ No newline at end of file
+// one buffer per thread, so lines logged by different threads don't interleave
+thread_local AndroidOut androidOut("AO");
+thread_local std::ostream aout(&androidOut);
\ No newline at end of file
@@ -1,19 +1,26 @@
 #ifndef ANDROIDGLINVESTIGATIONS_ANDROIDOUT_H
 #define ANDROIDGLINVESTIGATIONS_ANDROIDOUT_H
 
-#include <android/log.h>
 #include <sstream>
 
+#ifdef __ANDROID__
+#include <android/log.h>
+#else
+#include <cstdio>
+#endif
+
 /*!
- * Use this to log strings out to logcat. Note that you should use std::endl to commit the line
+ * Use this to log strings out to logcat (stderr on desktop). Note that you should use std::endl to commit the line
  *
  * ex:
  *  aout << "Hello World" << std::endl;
+ *
+ * Every thread has its own, so any thread can log.
  */
-extern std::ostream aout;
+extern thread_local std::ostream aout;
 
 /*!
- * Use this class to create an output stream that writes to logcat. By default, a global one is
+ * Use this class to create an output stream that writes to logcat. By default, one per thread is
  * defined as @a aout
  */
 class AndroidOut: public std::stringbuf {
@@ -26,7 +33,11 @@ public:
 
 protected:
     virtual int sync() override {
+#ifdef __ANDROID__
         __android_log_print(ANDROID_LOG_DEBUG, logTag_, "%s", str().c_str());
+#else
+        fprintf(stderr, "%s: %s", logTag_, str().c_str());
+#endif
         str("");
         return 0;
     }
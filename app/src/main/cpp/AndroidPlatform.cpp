@@ -0,0 +1,164 @@
+#include "AndroidPlatform.h"
+
+#include <filesystem>
+#include <game-activity/native_app_glue/android_native_app_glue.h>
+
+#include "AndroidOut.h"
+
+bool AndroidAssetProvider::readAsset(const std::string &assetPath, std::vector<uint8_t> &outData) {
+    auto pAsset = AAssetManager_open(
+            assetManager_,
+            assetPath.c_str(),
+            AASSET_MODE_BUFFER);
+    if (!pAsset) {
+        aout << "[ERROR] Failed to open asset " << assetPath << std::endl;
+        return false;
+    }
+    auto pBuffer = static_cast<const uint8_t *>(AAsset_getBuffer(pAsset));
+    size_t length = AAsset_getLength(pAsset);
+    outData.assign(pBuffer, pBuffer + length);
+    AAsset_close(pAsset);
+    return true;
+}
+
+/*!
+ * Keeps the AAsset open, its buffer lives as long as it does
+ */
+class AAssetMapping : public AssetMapping {
+public:
+    AAssetMapping(AAsset *asset, const void *buffer) : asset_(asset) {
+        data_ = static_cast<const uint8_t *>(buffer);
+        size_ = AAsset_getLength(asset);
+    }
+
+    ~AAssetMapping() override { AAsset_close(asset_); }
+
+private:
+    AAsset *asset_;
+};
+
+std::unique_ptr<AssetMapping> AndroidAssetProvider::mapAsset(const std::string &assetPath) {
+    auto pAsset = AAssetManager_open(assetManager_, assetPath.c_str(), AASSET_MODE_BUFFER);
+    if (!pAsset) {
+        return nullptr;
+    }
+    auto pBuffer = AAsset_getBuffer(pAsset);
+    if (!pBuffer) {
+        aout << "[ERROR] Failed to map asset " << assetPath << std::endl;
+        AAsset_close(pAsset);
+        return nullptr;
+    }
+    return std::make_unique<AAssetMapping>(pAsset, pBuffer);
+}
+
+AndroidPlatform::AndroidPlatform(android_app *pApp) :
+        app_(pApp),
+        assets_(pApp->activity->assetManager) {}
+
+EGLDisplay AndroidPlatform::getDisplay() {
+    // The default display is probably what you want on Android
+    return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+EGLint AndroidPlatform::getSurfaceType() const {
+    return EGL_WINDOW_BIT;
+}
+
+EGLSurface AndroidPlatform::createSurface(EGLDisplay display, EGLConfig config) {
+    // create the proper window surface
+    EGLint format;
+    eglGetConfigAttrib(display, config, EGL_NATIVE_VISUAL_ID, &format);
+    return eglCreateWindowSurface(display, config, app_->window, nullptr);
+}
+
+std::string AndroidPlatform::getCacheDir() const {
+    // GameActivity only exposes the files directory (/data/data/<package>/files), the cache
+    // directory is its sibling
+    const char *internalDataPath = app_->activity->internalDataPath;
+    if (!internalDataPath) {
+        return "";
+    }
+    return (std::filesystem::path(internalDataPath).parent_path() / "cache").string();
+}
+
+void AndroidPlatform::pollInput(InputEvents &outEvents) {
+    // handle all queued inputs
+    auto *inputBuffer = android_app_swap_input_buffers(app_);
+    if (!inputBuffer) {
+        // no inputs yet.
+        return;
+    }
+
+    // handle motion events (motionEventsCounts can be 0).
+    for (auto i = 0; i < inputBuffer->motionEventsCount; i++) {
+        auto &motionEvent = inputBuffer->motionEvents[i];
+        auto action = motionEvent.action;
+
+        // Find the pointer index, mask and bitshift to turn it into a readable value.
+        auto pointerIndex = (action & AMOTION_EVENT_ACTION_POINTER_INDEX_MASK)
+                >> AMOTION_EVENT_ACTION_POINTER_INDEX_SHIFT;
+
+        // get the x and y position of this event if it is not ACTION_MOVE.
+        auto &pointer = motionEvent.pointers[pointerIndex];
+        auto x = GameActivityPointerAxes_getX(&pointer);
+        auto y = GameActivityPointerAxes_getY(&pointer);
+
+        // determine the action type and translate the event accordingly.
+        switch (action & AMOTION_EVENT_ACTION_MASK) {
+            case AMOTION_EVENT_ACTION_DOWN:
+            case AMOTION_EVENT_ACTION_POINTER_DOWN:
+                outEvents.pointerEvents.push_back(
+                        {PointerEvent::Action::Down, pointer.id, x, y});
+                break;
+
+            case AMOTION_EVENT_ACTION_CANCEL:
+                outEvents.pointerEvents.push_back(
+                        {PointerEvent::Action::Cancel, pointer.id, x, y});
+                break;
+
+            case AMOTION_EVENT_ACTION_UP:
+            case AMOTION_EVENT_ACTION_POINTER_UP:
+                outEvents.pointerEvents.push_back(
+                        {PointerEvent::Action::Up, pointer.id, x, y});
+                break;
+
+            case AMOTION_EVENT_ACTION_MOVE:
+                // There is no pointer index for ACTION_MOVE, only a snapshot of
+                // all active pointers; report every one of them.
+                for (auto index = 0; index < motionEvent.pointerCount; index++) {
+                    auto &movedPointer = motionEvent.pointers[index];
+                    outEvents.pointerEvents.push_back(
+                            {PointerEvent::Action::Move,
+                             movedPointer.id,
+                             GameActivityPointerAxes_getX(&movedPointer),
+                             GameActivityPointerAxes_getY(&movedPointer)});
+                }
+                break;
+            default:
+                aout << "Unknown MotionEvent Action: " << action << std::endl;
+        }
+    }
+    // clear the motion input count in this buffer for main thread to re-use.
+    android_app_clear_motion_events(inputBuffer);
+
+    // handle input key events.
+    for (auto i = 0; i < inputBuffer->keyEventsCount; i++) {
+        auto &keyEvent = inputBuffer->keyEvents[i];
+        switch (keyEvent.action) {
+            case AKEY_EVENT_ACTION_DOWN:
+                outEvents.keyEvents.push_back({KeyEvent::Action::Down, keyEvent.keyCode});
+                break;
+            case AKEY_EVENT_ACTION_UP:
+                outEvents.keyEvents.push_back({KeyEvent::Action::Up, keyEvent.keyCode});
+                break;
+            case AKEY_EVENT_ACTION_MULTIPLE:
+                // Deprecated since Android API level 29.
+                outEvents.keyEvents.push_back({KeyEvent::Action::Multiple, keyEvent.keyCode});
+                break;
+            default:
+                aout << "Unknown KeyEvent Action: " << keyEvent.action << std::endl;
+        }
+    }
+    // clear the key input count too.
+    android_app_clear_key_events(inputBuffer);
+}
@@ -0,0 +1,63 @@
+#ifndef ANDROIDGLINVESTIGATIONS_ANDROIDPLATFORM_H
+#define ANDROIDGLINVESTIGATIONS_ANDROIDPLATFORM_H
+
+#include <android/asset_manager.h>
+
+#include "Platform.h"
+
+struct android_app;
+
+/*!
+ * Reads assets through the AAssetManager of the activity
+ */
+class AndroidAssetProvider : public AssetProvider {
+public:
+    inline AndroidAssetProvider(AAssetManager *assetManager) : assetManager_(assetManager) {}
+
+    bool readAsset(const std::string &assetPath, std::vector<uint8_t> &outData) override;
+
+    /*!
+     * Uses AAsset_getBuffer, which maps assets stored uncompressed in the APK (see noCompress in
+     * build.gradle) and inflates the others into memory
+     */
+    std::unique_ptr<AssetMapping> mapAsset(const std::string &assetPath) override;
+
+private:
+    AAssetManager *assetManager_;
+};
+
+/*!
+ * The Platform of a GameActivity: renders to the app window and reads the GameActivity input
+ * buffers.
+ */
+class AndroidPlatform : public Platform {
+public:
+    /*!
+     * @param pApp the android_app this platform belongs to, must have a window
+     */
+    AndroidPlatform(android_app *pApp);
+
+    EGLDisplay getDisplay() override;
+
+    EGLint getSurfaceType() const override;
+
+    EGLSurface createSurface(EGLDisplay display, EGLConfig config) override;
+
+    AssetProvider &getAssets() override { return assets_; }
+
+    /*!
+     * @return Context.getCacheDir(), the cache directory next to the app's files directory
+     */
+    std::string getCacheDir() const override;
+
+    /*!
+     * Note: this will clear the input queue of the android_app
+     */
+    void pollInput(InputEvents &outEvents) override;
+
+private:
+    android_app *app_;
+    AndroidAssetProvider assets_;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_ANDROIDPLATFORM_H
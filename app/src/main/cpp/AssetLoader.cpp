@@ -0,0 +1,109 @@
+#include "AssetLoader.h"
+
+void AssetLoader::start(unsigned threadCount) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = false;
+    for (unsigned i = 0; i < threadCount; i++) {
+        workers_.emplace_back(&AssetLoader::workerMain, this);
+    }
+}
+
+void AssetLoader::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    jobQueued_.notify_all();
+    uploadTaken_.notify_all();
+    for (auto &worker: workers_) {
+        worker.join();
+    }
+    workers_.clear();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    jobs_.clear();
+    uploads_.clear();
+    pendingCount_ = 0;
+}
+
+void AssetLoader::submit(Job job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        jobs_.push_back(std::move(job));
+        pendingCount_++;
+    }
+    jobQueued_.notify_one();
+}
+
+size_t AssetLoader::processUploads(std::chrono::steady_clock::duration budget) {
+    auto start = std::chrono::steady_clock::now();
+    size_t count = 0;
+    do {
+        Upload upload;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (uploads_.empty()) {
+                break;
+            }
+            upload = std::move(uploads_.front());
+            uploads_.pop_front();
+        }
+        uploadTaken_.notify_one();
+
+        upload();
+        count++;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        pendingCount_--;
+    } while (std::chrono::steady_clock::now() - start < budget);
+    return count;
+}
+
+void AssetLoader::finish() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (pendingCount_ > 0) {
+        if (workers_.empty()) {
+            // nobody would ever run the remaining jobs
+            return;
+        }
+        uploadQueued_.wait(lock, [this] { return !uploads_.empty() || pendingCount_ == 0; });
+        lock.unlock();
+        processUploads(std::chrono::steady_clock::duration::max());
+        lock.lock();
+    }
+}
+
+size_t AssetLoader::getPendingCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return pendingCount_;
+}
+
+void AssetLoader::workerMain() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        jobQueued_.wait(lock, [this] { return stopping_ || !jobs_.empty(); });
+        if (stopping_) {
+            return;
+        }
+        Job job = std::move(jobs_.front());
+        jobs_.pop_front();
+
+        lock.unlock();
+        Upload upload = job();
+        lock.lock();
+
+        if (!upload) {
+            pendingCount_--;
+            uploadQueued_.notify_all();
+            continue;
+        }
+        uploadTaken_.wait(lock, [this] {
+            return stopping_ || uploads_.size() < kMaxQueuedUploads;
+        });
+        if (stopping_) {
+            return;
+        }
+        uploads_.push_back(std::move(upload));
+        uploadQueued_.notify_all();
+    }
+}
@@ -0,0 +1,87 @@
+#ifndef ANDROIDGLINVESTIGATIONS_ASSETLOADER_H
+#define ANDROIDGLINVESTIGATIONS_ASSETLOADER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*!
+ * Loads assets in two steps: a job on a worker thread does everything that doesn't need GL
+ * (reading, importing, decoding) and returns an upload, which the render thread runs when it calls
+ * @a processUploads.
+ *
+ * Finished uploads wait in a bounded queue. A worker that would overflow it waits, so at most
+ * kMaxQueuedUploads decoded assets sit in memory ahead of the render thread.
+ */
+class AssetLoader {
+public:
+    /*!
+     * Runs on the render thread with the context current
+     */
+    using Upload = std::function<void()>;
+
+    /*!
+     * Runs on a worker thread, must not touch GL
+     * @return the upload of the asset, or an empty Upload if there's nothing to upload
+     */
+    using Job = std::function<Upload()>;
+
+    static constexpr size_t kMaxQueuedUploads = 4;
+
+    AssetLoader() = default;
+
+    ~AssetLoader() { stop(); }
+
+    AssetLoader(const AssetLoader &) = delete;
+
+    AssetLoader &operator=(const AssetLoader &) = delete;
+
+    /*!
+     * Starts @a threadCount workers
+     */
+    void start(unsigned threadCount);
+
+    /*!
+     * Joins the workers. Jobs that didn't start and uploads that didn't run are dropped.
+     */
+    void stop();
+
+    void submit(Job job);
+
+    /*!
+     * Runs queued uploads until the queue is empty or @a budget is spent. At least one upload runs
+     * if one is queued, an upload that takes longer than the budget would never run otherwise.
+     * @return the number of uploads that ran
+     */
+    size_t processUploads(std::chrono::steady_clock::duration budget);
+
+    /*!
+     * Waits for every submitted job and runs its upload
+     */
+    void finish();
+
+    /*!
+     * @return the jobs whose upload didn't run yet
+     */
+    size_t getPendingCount() const;
+
+private:
+    void workerMain();
+
+    std::vector<std::thread> workers_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable jobQueued_;
+    std::condition_variable uploadQueued_;
+    std::condition_variable uploadTaken_;
+    std::deque<Job> jobs_;
+    std::deque<Upload> uploads_;
+    size_t pendingCount_ = 0;
+    bool stopping_ = false;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_ASSETLOADER_H
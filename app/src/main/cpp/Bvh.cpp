@@ -0,0 +1,314 @@
+#include "Bvh.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace
+{
+float SurfaceArea(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+    glm::vec3 size = glm::max(boundsMax - boundsMin, glm::vec3(0.0f));
+    return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+struct FBin
+{
+    glm::vec3 boundsMin = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 boundsMax = glm::vec3(std::numeric_limits<float>::lowest());
+    uint32_t count = 0;
+
+    void Grow(const glm::vec3& otherMin, const glm::vec3& otherMax)
+    {
+        boundsMin = glm::min(boundsMin, otherMin);
+        boundsMax = glm::max(boundsMax, otherMax);
+    }
+};
+}
+
+FBvh::~FBvh()
+{
+    // the rebuild job writes into this object
+    if (mRebuilding)
+    {
+        jobSystem.wait(mRebuildCounter);
+    }
+}
+
+void FBvh::Update(const std::vector<glm::vec3>& boxesMin, const std::vector<glm::vec3>& boxesMax)
+{
+    bool sameObjects = mTree && boxesMin.size() == mBoxesMin.size();
+    mBoxesMin = boxesMin;
+    mBoxesMax = boxesMax;
+    if (!sameObjects)
+    {
+        // a rebuild in flight indexes the old objects
+        if (mRebuilding)
+        {
+            jobSystem.wait(mRebuildCounter);
+            mRebuilt.reset();
+            mRebuilding = false;
+        }
+        mTree = Build(mBoxesMin, mBoxesMax);
+        mCost = mTree->buildCost;
+        return;
+    }
+
+    Poll();
+    Refit();
+    if (!mRebuilding && mCost > mTree->buildCost * kRebuildCostRatio)
+    {
+        mRebuilding = true;
+        jobSystem.run([this, boxesMin = mBoxesMin, boxesMax = mBoxesMax]()
+        {
+            mRebuilt = Build(boxesMin, boxesMax);
+        }, &mRebuildCounter);
+    }
+}
+
+void FBvh::Poll()
+{
+    if (!mRebuilding || !mRebuildCounter.isDone())
+    {
+        return;
+    }
+    jobSystem.wait(mRebuildCounter);
+    mRebuilding = false;
+    // same objects, only the boxes may have moved since the snapshot
+    mTree = std::move(mRebuilt);
+    Refit();
+    mTree->buildCost = mCost;
+    mRebuildCount++;
+}
+
+void FBvh::CullFrustum(const FFrustum& frustum, std::vector<uint32_t>& outVisible) const
+{
+    if (!mTree || mTree->nodes.empty())
+    {
+        return;
+    }
+    struct FEntry
+    {
+        uint32_t node;
+        uint32_t planeMask;
+    };
+    std::vector<FEntry> stack = {{0, FFrustum::kAllPlanes}};
+    while (!stack.empty())
+    {
+        FEntry entry = stack.back();
+        stack.pop_back();
+        const FBvhNode& node = mTree->nodes[entry.node];
+        if (!frustum.TestBox(node.boundsMin, node.boundsMax, entry.planeMask))
+        {
+            continue;
+        }
+        if (entry.planeMask == 0)
+        {
+            // inside every plane, so is everything below. A subtree's objects are one run, from
+            // its leftmost to its rightmost leaf.
+            uint32_t leftmost = entry.node;
+            while (mTree->nodes[leftmost].count == 0)
+            {
+                leftmost++;
+            }
+            uint32_t rightmost = entry.node;
+            while (mTree->nodes[rightmost].count == 0)
+            {
+                rightmost = mTree->nodes[rightmost].first;
+            }
+            const FBvhNode& lastLeaf = mTree->nodes[rightmost];
+            outVisible.insert(outVisible.end(), mTree->objects.begin() + mTree->nodes[leftmost].first,
+                              mTree->objects.begin() + lastLeaf.first + lastLeaf.count);
+            continue;
+        }
+        if (node.count > 0)
+        {
+            for (uint32_t i = node.first; i < node.first + node.count; i++)
+            {
+                uint32_t object = mTree->objects[i];
+                uint32_t planeMask = entry.planeMask;
+                if (frustum.TestBox(mBoxesMin[object], mBoxesMax[object], planeMask))
+                {
+                    outVisible.push_back(object);
+                }
+            }
+            continue;
+        }
+        stack.push_back({node.first, entry.planeMask});
+        stack.push_back({entry.node + 1, entry.planeMask});
+    }
+}
+
+std::unique_ptr<FBvh::FTree> FBvh::Build(const std::vector<glm::vec3>& boxesMin, const std::vector<glm::vec3>& boxesMax)
+{
+    auto tree = std::make_unique<FTree>();
+    auto count = static_cast<uint32_t>(boxesMin.size());
+    if (count == 0)
+    {
+        return tree;
+    }
+    tree->objects.resize(count);
+    std::iota(tree->objects.begin(), tree->objects.end(), 0u);
+    std::vector<glm::vec3> centroids(count);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        centroids[i] = (boxesMin[i] + boxesMax[i]) * 0.5f;
+    }
+    // a binary tree with leaves of at least one object has fewer than twice as many nodes
+    tree->nodes.reserve(2 * count);
+    BuildNode(*tree, boxesMin, boxesMax, centroids, 0, count);
+    tree->buildCost = ComputeCost(*tree);
+    return tree;
+}
+
+uint32_t FBvh::BuildNode(FTree& tree, const std::vector<glm::vec3>& boxesMin, const std::vector<glm::vec3>& boxesMax,
+                         const std::vector<glm::vec3>& centroids, uint32_t begin, uint32_t end)
+{
+    auto index = static_cast<uint32_t>(tree.nodes.size());
+    tree.nodes.emplace_back();
+
+    FBin bounds;
+    glm::vec3 centroidMin(std::numeric_limits<float>::max());
+    glm::vec3 centroidMax(std::numeric_limits<float>::lowest());
+    for (uint32_t i = begin; i < end; i++)
+    {
+        uint32_t object = tree.objects[i];
+        bounds.Grow(boxesMin[object], boxesMax[object]);
+        centroidMin = glm::min(centroidMin, centroids[object]);
+        centroidMax = glm::max(centroidMax, centroids[object]);
+    }
+    tree.nodes[index].boundsMin = bounds.boundsMin;
+    tree.nodes[index].boundsMax = bounds.boundsMax;
+
+    uint32_t count = end - begin;
+    if (count <= kMaxLeafSize)
+    {
+        tree.nodes[index].first = begin;
+        tree.nodes[index].count = count;
+        return index;
+    }
+
+    // the split plane between two bins with the lowest left area * count + right area * count
+    glm::vec3 centroidExtent = centroidMax - centroidMin;
+    float bestCost = std::numeric_limits<float>::max();
+    int bestAxis = -1;
+    uint32_t bestSplit = 0;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        if (centroidExtent[axis] <= 0.0f)
+        {
+            continue;
+        }
+        float binScale = kBinCount / centroidExtent[axis];
+        FBin bins[kBinCount];
+        for (uint32_t i = begin; i < end; i++)
+        {
+            uint32_t object = tree.objects[i];
+            auto bin = std::min(uint32_t((centroids[object][axis] - centroidMin[axis]) * binScale), kBinCount - 1);
+            bins[bin].Grow(boxesMin[object], boxesMax[object]);
+            bins[bin].count++;
+        }
+        float rightCosts[kBinCount];
+        FBin right;
+        for (uint32_t bin = kBinCount - 1; bin > 0; bin--)
+        {
+            right.Grow(bins[bin].boundsMin, bins[bin].boundsMax);
+            right.count += bins[bin].count;
+            rightCosts[bin] = right.count ? SurfaceArea(right.boundsMin, right.boundsMax) * right.count : 0.0f;
+        }
+        FBin left;
+        for (uint32_t split = 1; split < kBinCount; split++)
+        {
+            left.Grow(bins[split - 1].boundsMin, bins[split - 1].boundsMax);
+            left.count += bins[split - 1].count;
+            float cost = (left.count ? SurfaceArea(left.boundsMin, left.boundsMax) * left.count : 0.0f) + rightCosts[split];
+            if (left.count > 0 && left.count < count && cost < bestCost)
+            {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = split;
+            }
+        }
+    }
+
+    uint32_t middle;
+    if (bestAxis >= 0)
+    {
+        float binScale = kBinCount / centroidExtent[bestAxis];
+        float axisMin = centroidMin[bestAxis];
+        auto* split = std::partition(tree.objects.data() + begin, tree.objects.data() + end, [&](uint32_t object)
+        {
+            return std::min(uint32_t((centroids[object][bestAxis] - axisMin) * binScale), kBinCount - 1) < bestSplit;
+        });
+        middle = static_cast<uint32_t>(split - tree.objects.data());
+    }
+    else
+    {
+        // every centroid in the same place, any halving is as good
+        middle = begin + count / 2;
+    }
+
+    BuildNode(tree, boxesMin, boxesMax, centroids, begin, middle);
+    uint32_t second = BuildNode(tree, boxesMin, boxesMax, centroids, middle, end);
+    tree.nodes[index].first = second;
+    tree.nodes[index].count = 0;
+    return index;
+}
+
+float FBvh::ComputeCost(const FTree& tree)
+{
+    if (tree.nodes.empty())
+    {
+        return 0.0f;
+    }
+    float rootArea = SurfaceArea(tree.nodes[0].boundsMin, tree.nodes[0].boundsMax);
+    if (rootArea <= 0.0f)
+    {
+        return 0.0f;
+    }
+    float cost = 0.0f;
+    for (const auto& node : tree.nodes)
+    {
+        float area = SurfaceArea(node.boundsMin, node.boundsMax);
+        cost += area * (node.count > 0 ? float(node.count) : kTraversalCost);
+    }
+    return cost / rootArea;
+}
+
+void FBvh::Refit()
+{
+    auto& nodes = mTree->nodes;
+    // children come after their parent
+    for (size_t i = nodes.size(); i-- > 0;)
+    {
+        FBvhNode& node = nodes[i];
+        FBin bounds;
+        if (node.count > 0)
+        {
+            for (uint32_t j = node.first; j < node.first + node.count; j++)
+            {
+                uint32_t object = mTree->objects[j];
+                bounds.Grow(mBoxesMin[object], mBoxesMax[object]);
+            }
+        }
+        else
+        {
+            bounds.Grow(nodes[i + 1].boundsMin, nodes[i + 1].boundsMax);
+            bounds.Grow(nodes[node.first].boundsMin, nodes[node.first].boundsMax);
+        }
+        node.boundsMin = bounds.boundsMin;
+        node.boundsMax = bounds.boundsMax;
+    }
+    mCost = ComputeCost(*mTree);
+}
+
+float FBvh::IntersectBox(const glm::vec3& origin, const glm::vec3& inverseDirection,
+                         const glm::vec3& boundsMin, const glm::vec3& boundsMax, float maxDistance)
+{
+    glm::vec3 t0 = (boundsMin - origin) * inverseDirection;
+    glm::vec3 t1 = (boundsMax - origin) * inverseDirection;
+    glm::vec3 tNear = glm::min(t0, t1);
+    glm::vec3 tFar = glm::max(t0, t1);
+    float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+    float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+    return enter <= exit ? enter : std::numeric_limits<float>::infinity();
+}
@@ -0,0 +1,194 @@
+#ifndef ANDROIDGLINVESTIGATIONS_BVH_H
+#define ANDROIDGLINVESTIGATIONS_BVH_H
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "Frustum.h"
+#include "JobSystem.h"
+
+/*!
+ * One node of an FBvh, 32 bytes. The first child of an inner node directly follows it.
+ */
+struct FBvhNode
+{
+    glm::vec3 boundsMin;
+    /*!
+     * Leaf: first entry of its objects in the object list. Inner node: index of the second child.
+     */
+    uint32_t first;
+    glm::vec3 boundsMax;
+    /*!
+     * Objects of a leaf, 0 for an inner node
+     */
+    uint32_t count;
+};
+
+/*!
+ * Bounding volume hierarchy over axis aligned object boxes, built with a binned surface area
+ * heuristic. Frustum culling and ray picking only descend into the nodes they touch, so their cost
+ * follows what's visible or hit instead of the object count.
+ *
+ * Moving objects refit the tree in place, which keeps it valid but lets its quality drift. Once
+ * the SAH cost of the refitted tree exceeds kRebuildCostRatio times the cost it was built with, a
+ * job rebuilds it from a snapshot of the boxes. The rebuilt tree replaces the refitted one at a
+ * later Update() or Poll(), refitted to the boxes of then.
+ */
+class FBvh
+{
+public:
+    static constexpr uint32_t kBinCount = 12;
+    static constexpr uint32_t kMaxLeafSize = 4;
+    /*!
+     * Cost of visiting a node relative to testing an object, for the SAH
+     */
+    static constexpr float kTraversalCost = 1.0f;
+    static constexpr float kRebuildCostRatio = 1.5f;
+
+    FBvh() = default;
+
+    ~FBvh();
+
+    FBvh(const FBvh&) = delete;
+
+    FBvh& operator=(const FBvh&) = delete;
+
+    /*!
+     * Takes the boxes of the objects, object i being boxesMin[i], boxesMax[i]. Refits the tree if
+     * the object count is unchanged, builds it otherwise.
+     */
+    void Update(const std::vector<glm::vec3>& boxesMin, const std::vector<glm::vec3>& boxesMax);
+
+    /*!
+     * Swaps in a finished background rebuild, call it once a frame
+     */
+    void Poll();
+
+    /*!
+     * Appends the objects whose box touches @a frustum, conservative like FFrustum::CullBoxes.
+     * Subtrees entirely inside the frustum are taken without testing their objects.
+     */
+    void CullFrustum(const FFrustum& frustum, std::vector<uint32_t>& outVisible) const;
+
+    /*!
+     * Finds the closest object along a ray. The boxes only narrow the candidates down, @a hit
+     * decides whether the ray really hits an object and where.
+     * @param direction normalized
+     * @param inOutDistance the furthest distance to look at, the distance of the hit on return
+     * @param outObject the object hit
+     * @param hit bool(uint32_t object, float& distance), true if the ray hits @a object, closer
+     * than @a distance, which it sets to the distance of the hit
+     * @return true if anything was hit
+     */
+    template<typename HitFunction>
+    bool Raycast(const glm::vec3& origin, const glm::vec3& direction, float& inOutDistance,
+                 uint32_t& outObject, const HitFunction& hit) const;
+
+    /*!
+     * @param inverseDirection 1 / the direction of the ray
+     * @return the distance the ray enters the box at, in units of the direction, infinity if it
+     * misses the box or only hits it further than @a maxDistance
+     */
+    static float IntersectBox(const glm::vec3& origin, const glm::vec3& inverseDirection,
+                              const glm::vec3& boundsMin, const glm::vec3& boundsMax, float maxDistance);
+
+    size_t GetObjectCount() const { return mBoxesMin.size(); }
+
+    size_t GetNodeCount() const { return mTree ? mTree->nodes.size() : 0; }
+
+    /*!
+     * @return the SAH cost of the tree as it is, and as it was built
+     */
+    float GetCost() const { return mCost; }
+
+    float GetBuildCost() const { return mTree ? mTree->buildCost : 0.0f; }
+
+    /*!
+     * @return how often a background rebuild replaced the tree
+     */
+    size_t GetRebuildCount() const { return mRebuildCount; }
+
+private:
+    struct FTree
+    {
+        std::vector<FBvhNode> nodes;
+        // object indices, every leaf owns a contiguous run
+        std::vector<uint32_t> objects;
+        float buildCost = 0.0f;
+    };
+
+    static std::unique_ptr<FTree> Build(const std::vector<glm::vec3>& boxesMin, const std::vector<glm::vec3>& boxesMax);
+
+    static uint32_t BuildNode(FTree& tree, const std::vector<glm::vec3>& boxesMin, const std::vector<glm::vec3>& boxesMax,
+                              const std::vector<glm::vec3>& centroids, uint32_t begin, uint32_t end);
+
+    static float ComputeCost(const FTree& tree);
+
+    void Refit();
+
+    std::vector<glm::vec3> mBoxesMin;
+    std::vector<glm::vec3> mBoxesMax;
+    std::unique_ptr<FTree> mTree;
+    float mCost = 0.0f;
+
+    // the background rebuild, its job only touches mRebuilt and its snapshot of the boxes
+    JobSystem::Counter mRebuildCounter;
+    std::unique_ptr<FTree> mRebuilt;
+    bool mRebuilding = false;
+    size_t mRebuildCount = 0;
+};
+
+template<typename HitFunction>
+bool FBvh::Raycast(const glm::vec3& origin, const glm::vec3& direction, float& inOutDistance,
+                   uint32_t& outObject, const HitFunction& hit) const
+{
+    if (!mTree || mTree->nodes.empty())
+    {
+        return false;
+    }
+    glm::vec3 inverseDirection = 1.0f / direction;
+    bool found = false;
+    std::vector<uint32_t> stack = {0};
+    while (!stack.empty())
+    {
+        const FBvhNode& node = mTree->nodes[stack.back()];
+        stack.pop_back();
+        if (IntersectBox(origin, inverseDirection, node.boundsMin, node.boundsMax, inOutDistance)
+            == std::numeric_limits<float>::infinity())
+        {
+            continue;
+        }
+        if (node.count > 0)
+        {
+            for (uint32_t i = node.first; i < node.first + node.count; i++)
+            {
+                uint32_t object = mTree->objects[i];
+                if (IntersectBox(origin, inverseDirection, mBoxesMin[object], mBoxesMax[object], inOutDistance)
+                    != std::numeric_limits<float>::infinity() && hit(object, inOutDistance))
+                {
+                    outObject = object;
+                    found = true;
+                }
+            }
+            continue;
+        }
+        // the nearer child goes on top, so its hits shorten the ray before the other is tested
+        uint32_t nearChild = uint32_t(&node - mTree->nodes.data()) + 1;
+        uint32_t farChild = node.first;
+        const FBvhNode& nearNode = mTree->nodes[nearChild];
+        const FBvhNode& farNode = mTree->nodes[farChild];
+        if (IntersectBox(origin, inverseDirection, nearNode.boundsMin, nearNode.boundsMax, inOutDistance)
+            > IntersectBox(origin, inverseDirection, farNode.boundsMin, farNode.boundsMax, inOutDistance))
+        {
+            std::swap(nearChild, farChild);
+        }
+        stack.push_back(farChild);
+        stack.push_back(nearChild);
+    }
+    return found;
+}
+
+#endif //ANDROIDGLINVESTIGATIONS_BVH_H
@@ -0,0 +1,10 @@
+#include "CameraBuffer.h"
+
+void CameraBuffer::update(StreamBuffer &stream, const CameraConstants &constants) {
+    auto allocation = stream.writeUniform(constants);
+    if (!allocation) {
+        return;
+    }
+    glBindBufferRange(GL_UNIFORM_BUFFER, kBinding, stream.getBuffer(), allocation.offset,
+                      sizeof(CameraConstants));
+}
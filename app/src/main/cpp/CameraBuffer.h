@@ -0,0 +1,42 @@
+#ifndef ANDROIDGLINVESTIGATIONS_CAMERABUFFER_H
+#define ANDROIDGLINVESTIGATIONS_CAMERABUFFER_H
+
+#include <GLES3/gl31.h>
+#include <glm/glm.hpp>
+
+#include "StreamBuffer.h"
+
+/*!
+ * The per-frame camera constants, laid out like the std140 Camera uniform block:
+ *
+ *     layout(std140) uniform Camera {
+ *         mat4 view;
+ *         mat4 projection;
+ *         mat4 viewProjection;
+ *     };
+ */
+struct CameraConstants {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 viewProjection;
+};
+
+/*!
+ * Feeds the Camera block, bound to kBinding. Shaders using the block map it with
+ * Shader::setUniformBlockBinding(kBlockName, kBinding) once after loading, then never set a
+ * camera uniform again.
+ */
+class CameraBuffer {
+public:
+    static constexpr GLuint kBinding = 0;
+
+    static constexpr const char *kBlockName = "Camera";
+
+    /*!
+     * Writes this frame's constants to @a stream, which has to be mapped, and binds them to
+     * kBinding
+     */
+    void update(StreamBuffer &stream, const CameraConstants &constants);
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_CAMERABUFFER_H
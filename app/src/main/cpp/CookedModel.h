@@ -0,0 +1,96 @@
+#ifndef ANDROIDGLINVESTIGATIONS_COOKEDMODEL_H
+#define ANDROIDGLINVESTIGATIONS_COOKEDMODEL_H
+
+#include <cstdint>
+
+/*!
+ * Layout of a cooked model (.mesh), written by mesh_cooker and read by FModel::ImportAsset:
+ *
+ *   FCookedModelHeader
+ *   FPackedVertex[vertexCount]       at verticesOffset
+ *   Index[indexCount]                at indicesOffset
+ *   FCookedMesh[meshCount]           at meshesOffset
+ *   FCookedMaterial[materialCount]   at materialsOffset
+ *   FMeshlet[meshletCount]           at meshletsOffset
+ *
+ * Every section starts at a multiple of kCookedModelAlignment. The streams are exactly what
+ * GenerateVAO uploads, so a mapped blob goes to GL as it is. Little endian, like every target.
+ */
+static constexpr uint32_t kCookedModelMagic = 0x4C444D46; // "FMDL"
+static constexpr uint32_t kCookedModelVersion = 3;
+static constexpr uint32_t kCookedModelAlignment = 16;
+/*!
+ * Levels of detail a mesh can have, the full one included
+ */
+static constexpr uint32_t kCookedMaxLods = 4;
+
+struct FCookedModelHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    /*!
+     * sizeof(FPackedVertex) and sizeof(Index) of the cooker, a blob of another layout is rejected
+     */
+    uint32_t vertexStride;
+    uint32_t indexSize;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t meshCount;
+    uint32_t materialCount;
+    /*!
+     * Dequantizes the positions, see FModel::GetPositionScale
+     */
+    float positionScale[3];
+    float positionOffset[3];
+    uint32_t verticesOffset;
+    uint32_t indicesOffset;
+    uint32_t meshesOffset;
+    uint32_t materialsOffset;
+    /*!
+     * Size of the whole blob, a truncated file doesn't match it
+     */
+    uint32_t fileSize;
+    /*!
+     * The meshlets of every mesh and LOD in mesh order, their ranges of the index buffer are
+     * contiguous
+     */
+    uint32_t meshletCount;
+    uint32_t meshletsOffset;
+    uint32_t reserved;
+};
+static_assert(sizeof(FCookedModelHeader) == 88, "FCookedModelHeader is part of the file format");
+
+struct FCookedMesh
+{
+    int32_t vertexOffset;
+    uint32_t vertexCount;
+    uint32_t indexOffset;
+    uint32_t indexCount;
+    float boundsMin[3];
+    float boundsMax[3];
+    /*!
+     * Index into the material table, -1 if the mesh has none
+     */
+    int32_t material;
+    /*!
+     * Levels of detail, the full one included. Level i > 0 is the index range at
+     * lodIndexOffset[i - 1] over the same vertices, its surface up to lodError[i - 1] away from the
+     * full one.
+     */
+    uint32_t lodCount;
+    uint32_t lodIndexOffset[kCookedMaxLods - 1];
+    uint32_t lodIndexCount[kCookedMaxLods - 1];
+    float lodError[kCookedMaxLods - 1];
+};
+static_assert(sizeof(FCookedMesh) == 84, "FCookedMesh is part of the file format");
+
+struct FCookedMaterial
+{
+    /*!
+     * Base color texture relative to the model's directory, empty if there's none
+     */
+    char baseColorTexture[128];
+};
+static_assert(sizeof(FCookedMaterial) == 128, "FCookedMaterial is part of the file format");
+
+#endif //ANDROIDGLINVESTIGATIONS_COOKEDMODEL_H
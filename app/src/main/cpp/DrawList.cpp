@@ -0,0 +1,51 @@
+#include "DrawList.h"
+
+#include <algorithm>
+#include <cmath>
+
+uint64_t FDrawList::MakeKey(uint32_t program, uint32_t material, uint32_t vertexArray, float depth)
+{
+    constexpr uint32_t kDepthMax = (1u << kDepthBits) - 1;
+    // NaN goes to the far end
+    float clamped = std::isnan(depth) ? 1.0f : std::clamp(depth, 0.0f, 1.0f);
+    auto quantizedDepth = static_cast<uint32_t>(clamped * kDepthMax);
+    return (uint64_t(program & 0xFFu) << 56)
+           | (uint64_t(material & 0xFFFFu) << 40)
+           | (uint64_t(vertexArray & 0xFFFFu) << kDepthBits)
+           | quantizedDepth;
+}
+
+void FDrawList::Sort()
+{
+    if (mItems.size() < 2)
+    {
+        return;
+    }
+    mScratch.resize(mItems.size());
+
+    for (int shift = 0; shift < 64; shift += 8)
+    {
+        size_t counts[256] = {};
+        for (const auto& item : mItems)
+        {
+            counts[(item.key >> shift) & 0xFF]++;
+        }
+        if (counts[(mItems[0].key >> shift) & 0xFF] == mItems.size())
+        {
+            continue;
+        }
+
+        size_t offset = 0;
+        for (auto& count : counts)
+        {
+            size_t digitCount = count;
+            count = offset;
+            offset += digitCount;
+        }
+        for (const auto& item : mItems)
+        {
+            mScratch[counts[(item.key >> shift) & 0xFF]++] = item;
+        }
+        mItems.swap(mScratch);
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef ANDROIDGLINVESTIGATIONS_DRAWLIST_H
+#define ANDROIDGLINVESTIGATIONS_DRAWLIST_H
+
+#include <cstdint>
+#include <vector>
+
+/*!
+ * One submesh draw of a frame. The key decides the submission order, model and mesh say what to
+ * draw.
+ */
+struct FDrawItem
+{
+    uint64_t key;
+    uint32_t model;
+    uint32_t mesh;
+};
+
+/*!
+ * The draws of a pass, sorted by a 64 bit key so draws sharing state end up next to each other.
+ * From the most significant bit:
+ *
+ *   program (8) | material (16) | vertex array (16) | depth (24)
+ *
+ * State ids are masked to their field, an alias only costs a bind the submission can't elide.
+ * Within the same state the draws go front to back, so early depth rejects what's behind them.
+ */
+class FDrawList
+{
+public:
+    static constexpr int kDepthBits = 24;
+
+    /*!
+     * @param depth normalized distance from the camera, clamped to [0, 1]
+     */
+    static uint64_t MakeKey(uint32_t program, uint32_t material, uint32_t vertexArray, float depth);
+
+    void Clear() { mItems.clear(); }
+
+    void Add(uint64_t key, uint32_t model, uint32_t mesh) { mItems.push_back({key, model, mesh}); }
+
+    /*!
+     * Stable LSD radix sort on the key, one byte per pass. Passes where every key has the same
+     * byte are skipped, so unused state fields cost nothing.
+     */
+    void Sort();
+
+    const std::vector<FDrawItem>& GetItems() const { return mItems; }
+
+private:
+    std::vector<FDrawItem> mItems;
+    std::vector<FDrawItem> mScratch;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_DRAWLIST_H
@@ -0,0 +1,200 @@
+//
+// CPU frustum culling of axis aligned boxes, four boxes per iteration.
+//
+#include "Frustum.h"
+
+#include <cmath>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+void FBoundsSoA::Add(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+    glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+    glm::vec3 extent = (boundsMax - boundsMin) * 0.5f;
+
+    // the padding lanes are overwritten first, a new lane block is padded with empty boxes
+    if (count == centerX.size())
+    {
+        size_t padded = count + kLaneCount;
+        for (auto* component : {&centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ})
+        {
+            component->resize(padded, 0.0f);
+        }
+    }
+    centerX[count] = center.x;
+    centerY[count] = center.y;
+    centerZ[count] = center.z;
+    extentX[count] = extent.x;
+    extentY[count] = extent.y;
+    extentZ[count] = extent.z;
+    count++;
+}
+
+void FBoundsSoA::Clear()
+{
+    count = 0;
+    for (auto* component : {&centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ})
+    {
+        component->clear();
+    }
+}
+
+FFrustum FFrustum::FromViewProjection(const glm::mat4& viewProjection)
+{
+    // glm is column major, m[column][row]
+    auto row = [&viewProjection](int i) {
+        return glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+    };
+
+    FFrustum frustum;
+    frustum.planes[0] = row(3) + row(0); // left
+    frustum.planes[1] = row(3) - row(0); // right
+    frustum.planes[2] = row(3) + row(1); // bottom
+    frustum.planes[3] = row(3) - row(1); // top
+    frustum.planes[4] = row(3) + row(2); // near
+    frustum.planes[5] = row(3) - row(2); // far
+    for (auto& plane : frustum.planes)
+    {
+        plane /= glm::length(glm::vec3(plane));
+    }
+    return frustum;
+}
+
+namespace
+{
+// Appends the lanes of a block whose bit is set in visibleMask
+inline void AppendVisible(uint32_t visibleMask, size_t first, size_t count, std::vector<uint32_t>& outVisible)
+{
+    while (visibleMask)
+    {
+        size_t index = first + __builtin_ctz(visibleMask);
+        if (index < count)
+        {
+            outVisible.push_back(static_cast<uint32_t>(index));
+        }
+        visibleMask &= visibleMask - 1;
+    }
+}
+}
+
+void FFrustum::CullBoxes(const FBoundsSoA& bounds, std::vector<uint32_t>& outVisible) const
+{
+    // A box is outside a plane when its center is further behind it than the box's projected
+    // radius: dot(n, c) + d + dot(|n|, e) < 0
+    const size_t padded = bounds.centerX.size();
+#if defined(__ARM_NEON)
+    float32x4_t planeX[6], planeY[6], planeZ[6], planeW[6], absX[6], absY[6], absZ[6];
+    for (int p = 0; p < 6; p++)
+    {
+        planeX[p] = vdupq_n_f32(planes[p].x);
+        planeY[p] = vdupq_n_f32(planes[p].y);
+        planeZ[p] = vdupq_n_f32(planes[p].z);
+        planeW[p] = vdupq_n_f32(planes[p].w);
+        absX[p] = vabsq_f32(planeX[p]);
+        absY[p] = vabsq_f32(planeY[p]);
+        absZ[p] = vabsq_f32(planeZ[p]);
+    }
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    for (size_t i = 0; i < padded; i += FBoundsSoA::kLaneCount)
+    {
+        float32x4_t cx = vld1q_f32(&bounds.centerX[i]);
+        float32x4_t cy = vld1q_f32(&bounds.centerY[i]);
+        float32x4_t cz = vld1q_f32(&bounds.centerZ[i]);
+        float32x4_t ex = vld1q_f32(&bounds.extentX[i]);
+        float32x4_t ey = vld1q_f32(&bounds.extentY[i]);
+        float32x4_t ez = vld1q_f32(&bounds.extentZ[i]);
+        uint32x4_t outside = vdupq_n_u32(0);
+        for (int p = 0; p < 6; p++)
+        {
+            float32x4_t distance = vmlaq_f32(vmlaq_f32(vmlaq_f32(planeW[p], planeX[p], cx), planeY[p], cy), planeZ[p], cz);
+            float32x4_t radius = vmlaq_f32(vmlaq_f32(vmulq_f32(absX[p], ex), absY[p], ey), absZ[p], ez);
+            outside = vorrq_u32(outside, vcltq_f32(vaddq_f32(distance, radius), zero));
+        }
+        uint32_t visibleMask = (vgetq_lane_u32(outside, 0) ? 0u : 1u)
+                               | (vgetq_lane_u32(outside, 1) ? 0u : 2u)
+                               | (vgetq_lane_u32(outside, 2) ? 0u : 4u)
+                               | (vgetq_lane_u32(outside, 3) ? 0u : 8u);
+        AppendVisible(visibleMask, i, bounds.count, outVisible);
+    }
+#elif defined(__SSE2__)
+    __m128 planeX[6], planeY[6], planeZ[6], planeW[6], absX[6], absY[6], absZ[6];
+    for (int p = 0; p < 6; p++)
+    {
+        planeX[p] = _mm_set1_ps(planes[p].x);
+        planeY[p] = _mm_set1_ps(planes[p].y);
+        planeZ[p] = _mm_set1_ps(planes[p].z);
+        planeW[p] = _mm_set1_ps(planes[p].w);
+        absX[p] = _mm_set1_ps(std::fabs(planes[p].x));
+        absY[p] = _mm_set1_ps(std::fabs(planes[p].y));
+        absZ[p] = _mm_set1_ps(std::fabs(planes[p].z));
+    }
+    const __m128 zero = _mm_setzero_ps();
+    for (size_t i = 0; i < padded; i += FBoundsSoA::kLaneCount)
+    {
+        __m128 cx = _mm_loadu_ps(&bounds.centerX[i]);
+        __m128 cy = _mm_loadu_ps(&bounds.centerY[i]);
+        __m128 cz = _mm_loadu_ps(&bounds.centerZ[i]);
+        __m128 ex = _mm_loadu_ps(&bounds.extentX[i]);
+        __m128 ey = _mm_loadu_ps(&bounds.extentY[i]);
+        __m128 ez = _mm_loadu_ps(&bounds.extentZ[i]);
+        __m128 outside = _mm_setzero_ps();
+        for (int p = 0; p < 6; p++)
+        {
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], cx), _mm_mul_ps(planeY[p], cy)),
+                                         _mm_add_ps(_mm_mul_ps(planeZ[p], cz), planeW[p]));
+            __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(absX[p], ex), _mm_mul_ps(absY[p], ey)),
+                                       _mm_mul_ps(absZ[p], ez));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), zero));
+        }
+        uint32_t visibleMask = ~static_cast<uint32_t>(_mm_movemask_ps(outside)) & 0xFu;
+        AppendVisible(visibleMask, i, bounds.count, outVisible);
+    }
+#else
+    for (size_t i = 0; i < padded; i += FBoundsSoA::kLaneCount)
+    {
+        uint32_t visibleMask = 0;
+        for (size_t lane = 0; lane < FBoundsSoA::kLaneCount; lane++)
+        {
+            size_t box = i + lane;
+            bool outside = false;
+            for (const auto& plane : planes)
+            {
+                float distance = plane.x * bounds.centerX[box] + plane.y * bounds.centerY[box] + plane.z * bounds.centerZ[box] + plane.w;
+                float radius = std::fabs(plane.x) * bounds.extentX[box] + std::fabs(plane.y) * bounds.extentY[box] + std::fabs(plane.z) * bounds.extentZ[box];
+                outside |= distance + radius < 0.0f;
+            }
+            visibleMask |= outside ? 0u : (1u << lane);
+        }
+        AppendVisible(visibleMask, i, bounds.count, outVisible);
+    }
+#endif
+}
+
+bool FFrustum::TestBox(const glm::vec3& boundsMin, const glm::vec3& boundsMax, uint32_t& inOutPlaneMask) const
+{
+    glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+    glm::vec3 extent = (boundsMax - boundsMin) * 0.5f;
+    for (int p = 0; p < 6; p++)
+    {
+        if (!(inOutPlaneMask & (1u << p)))
+        {
+            continue;
+        }
+        const glm::vec4& plane = planes[p];
+        float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+        float radius = glm::dot(glm::abs(glm::vec3(plane)), extent);
+        if (distance + radius < 0.0f)
+        {
+            return false;
+        }
+        if (distance - radius >= 0.0f)
+        {
+            inOutPlaneMask &= ~(1u << p);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,64 @@
+#ifndef ANDROIDGLINVESTIGATIONS_FRUSTUM_H
+#define ANDROIDGLINVESTIGATIONS_FRUSTUM_H
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+/*!
+ * Axis aligned boxes stored as structure of arrays (center and half extent per axis), so the
+ * frustum test can load the same component of several boxes at once. The arrays are padded to a
+ * multiple of kLaneCount with empty boxes.
+ */
+struct FBoundsSoA
+{
+    static constexpr size_t kLaneCount = 4;
+
+    void Add(const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+
+    void Clear();
+
+    size_t Size() const { return count; }
+
+    size_t count = 0;
+    std::vector<float> centerX;
+    std::vector<float> centerY;
+    std::vector<float> centerZ;
+    std::vector<float> extentX;
+    std::vector<float> extentY;
+    std::vector<float> extentZ;
+};
+
+/*!
+ * The six planes of a view frustum. A point p is inside when dot(plane.xyz, p) + plane.w >= 0 for
+ * every plane.
+ */
+struct FFrustum
+{
+    static constexpr uint32_t kAllPlanes = 0x3F;
+
+    /*!
+     * Extracts the planes from a GL clip space matrix (Gribb/Hartmann)
+     */
+    static FFrustum FromViewProjection(const glm::mat4& viewProjection);
+
+    /*!
+     * Tests kLaneCount boxes per iteration with SSE or NEON, scalar elsewhere. Boxes that touch the
+     * frustum are kept, the test is conservative near the frustum corners.
+     * @param bounds the boxes to test
+     * @param outVisible receives the indices of the boxes that may be visible, in order
+     */
+    void CullBoxes(const FBoundsSoA& bounds, std::vector<uint32_t>& outVisible) const;
+
+    /*!
+     * Tests one box against the planes whose bit is set in @a inOutPlaneMask and clears the bits
+     * of the planes the box is entirely inside of, so the boxes within it can skip them. Same
+     * conservative test as CullBoxes.
+     * @return false if the box is outside
+     */
+    bool TestBox(const glm::vec3& boundsMin, const glm::vec3& boundsMax, uint32_t& inOutPlaneMask) const;
+
+    glm::vec4 planes[6];
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_FRUSTUM_H
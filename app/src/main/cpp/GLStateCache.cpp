@@ -0,0 +1,159 @@
+#include "GLStateCache.h"
+
+GLStateCache glState;
+
+void GLStateCache::invalidate() {
+    program_ = kUnknown;
+    vertexArray_ = kUnknown;
+    framebuffer_ = kUnknown;
+    activeUnit_ = kUnknown;
+    textures_.fill(kUnknown);
+    enabled_.fill(-1);
+    depthFunc_ = kUnknown;
+    depthMask_ = -1;
+    blendSource_ = kUnknown;
+    blendDestination_ = kUnknown;
+    viewport_.fill(-1);
+}
+
+void GLStateCache::useProgram(GLuint program) {
+    if (changes(program != program_)) {
+        glUseProgram(program);
+        program_ = program;
+    }
+}
+
+void GLStateCache::bindVertexArray(GLuint vertexArray) {
+    if (changes(vertexArray != vertexArray_)) {
+        glBindVertexArray(vertexArray);
+        vertexArray_ = vertexArray;
+    }
+}
+
+void GLStateCache::bindTexture(GLuint unit, GLenum target, GLuint texture) {
+    bool shadowed = unit < kTextureUnits && target == GL_TEXTURE_2D;
+    if (shadowed && textures_[unit] == texture) {
+        changes(false);
+        return;
+    }
+    if (changes(unit != activeUnit_)) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        activeUnit_ = unit;
+    }
+    issued_++;
+    glBindTexture(target, texture);
+    if (shadowed) {
+        textures_[unit] = texture;
+    }
+}
+
+void GLStateCache::bindFramebuffer(GLuint framebuffer) {
+    if (changes(framebuffer != framebuffer_)) {
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        framebuffer_ = framebuffer;
+    }
+}
+
+void GLStateCache::setEnabled(GLenum capability, bool enabled) {
+    int index = capabilityIndex(capability);
+    if (index < 0) {
+        issued_++;
+        enabled ? glEnable(capability) : glDisable(capability);
+        return;
+    }
+    if (changes(enabled_[index] != int8_t(enabled))) {
+        enabled ? glEnable(capability) : glDisable(capability);
+        enabled_[index] = int8_t(enabled);
+    }
+}
+
+void GLStateCache::depthFunc(GLenum func) {
+    if (changes(func != depthFunc_)) {
+        glDepthFunc(func);
+        depthFunc_ = func;
+    }
+}
+
+void GLStateCache::depthMask(bool mask) {
+    if (changes(int8_t(mask) != depthMask_)) {
+        glDepthMask(mask ? GL_TRUE : GL_FALSE);
+        depthMask_ = int8_t(mask);
+    }
+}
+
+void GLStateCache::blendFunc(GLenum sourceFactor, GLenum destinationFactor) {
+    if (changes(sourceFactor != blendSource_ || destinationFactor != blendDestination_)) {
+        glBlendFunc(sourceFactor, destinationFactor);
+        blendSource_ = sourceFactor;
+        blendDestination_ = destinationFactor;
+    }
+}
+
+void GLStateCache::viewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+    std::array<GLint, 4> viewport = {x, y, width, height};
+    if (changes(viewport != viewport_)) {
+        glViewport(x, y, width, height);
+        viewport_ = viewport;
+    }
+}
+
+void GLStateCache::deleteProgram(GLuint program) {
+    glDeleteProgram(program);
+    if (program != 0 && program == program_) {
+        // a bound program lives on until it's unbound, but a new program may reuse the name
+        program_ = kUnknown;
+    }
+}
+
+void GLStateCache::deleteVertexArrays(GLsizei count, const GLuint *vertexArrays) {
+    glDeleteVertexArrays(count, vertexArrays);
+    for (GLsizei i = 0; i < count; i++) {
+        if (vertexArrays[i] != 0 && vertexArrays[i] == vertexArray_) {
+            vertexArray_ = 0;
+        }
+    }
+}
+
+void GLStateCache::deleteTextures(GLsizei count, const GLuint *textures) {
+    glDeleteTextures(count, textures);
+    for (GLsizei i = 0; i < count; i++) {
+        for (auto &bound: textures_) {
+            if (textures[i] != 0 && bound == textures[i]) {
+                bound = 0;
+            }
+        }
+    }
+}
+
+void GLStateCache::deleteFramebuffers(GLsizei count, const GLuint *framebuffers) {
+    glDeleteFramebuffers(count, framebuffers);
+    for (GLsizei i = 0; i < count; i++) {
+        if (framebuffers[i] != 0 && framebuffers[i] == framebuffer_) {
+            framebuffer_ = 0;
+        }
+    }
+}
+
+void GLStateCache::endFrame() {
+    lastElided_ = elided_;
+    lastIssued_ = issued_;
+    elided_ = 0;
+    issued_ = 0;
+}
+
+int GLStateCache::capabilityIndex(GLenum capability) {
+    switch (capability) {
+        case GL_BLEND:
+            return kBlend;
+        case GL_CULL_FACE:
+            return kCullFace;
+        case GL_DEPTH_TEST:
+            return kDepthTest;
+        case GL_SCISSOR_TEST:
+            return kScissorTest;
+        case GL_STENCIL_TEST:
+            return kStencilTest;
+        default:
+            return -1;
+    }
+}
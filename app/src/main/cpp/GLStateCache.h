@@ -0,0 +1,126 @@
+#ifndef ANDROIDGLINVESTIGATIONS_GLSTATECACHE_H
+#define ANDROIDGLINVESTIGATIONS_GLSTATECACHE_H
+
+#include <GLES3/gl31.h>
+#include <array>
+#include <cstdint>
+
+/*!
+ * Shadows the GL state the renderer changes most and skips calls that would set what is already
+ * set. Every bind, enable and delete of the tracked state has to go through here, or the shadow
+ * goes stale; @a invalidate resynchronizes after code that bypassed it.
+ *
+ * Deleting a bound object makes GL bind 0 in its place, the delete functions do the same to the
+ * shadow so a recycled name never looks bound.
+ */
+class GLStateCache {
+public:
+    static constexpr GLuint kTextureUnits = 16;
+
+    GLStateCache() { invalidate(); }
+
+    /*!
+     * Forgets all state, so the next call of every kind reaches GL. Call it after making a new
+     * context current.
+     */
+    void invalidate();
+
+    void useProgram(GLuint program);
+
+    void bindVertexArray(GLuint vertexArray);
+
+    /*!
+     * Binds @a texture to @a unit, switching the active texture unit only if needed. Units beyond
+     * kTextureUnits and targets other than GL_TEXTURE_2D aren't shadowed.
+     */
+    void bindTexture(GLuint unit, GLenum target, GLuint texture);
+
+    /*!
+     * Binds GL_FRAMEBUFFER, i.e. both the draw and the read framebuffer
+     */
+    void bindFramebuffer(GLuint framebuffer);
+
+    /*!
+     * Shadows GL_BLEND, GL_CULL_FACE, GL_DEPTH_TEST, GL_SCISSOR_TEST and GL_STENCIL_TEST, other
+     * capabilities always reach GL
+     */
+    void setEnabled(GLenum capability, bool enabled);
+
+    void depthFunc(GLenum func);
+
+    void depthMask(bool mask);
+
+    void blendFunc(GLenum sourceFactor, GLenum destinationFactor);
+
+    void viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+
+    void deleteProgram(GLuint program);
+
+    void deleteVertexArrays(GLsizei count, const GLuint *vertexArrays);
+
+    void deleteTextures(GLsizei count, const GLuint *textures);
+
+    void deleteFramebuffers(GLsizei count, const GLuint *framebuffers);
+
+    /*!
+     * Latches the call counts of the frame and starts counting the next one
+     */
+    void endFrame();
+
+    /*!
+     * @return the calls skipped during the last frame
+     */
+    uint32_t getElidedCalls() const { return lastElided_; }
+
+    /*!
+     * @return the calls passed on to GL during the last frame
+     */
+    uint32_t getIssuedCalls() const { return lastIssued_; }
+
+private:
+    enum Capability {
+        kBlend,
+        kCullFace,
+        kDepthTest,
+        kScissorTest,
+        kStencilTest,
+        kCapabilityCount
+    };
+
+    static int capabilityIndex(GLenum capability);
+
+    /*!
+     * Counts the call, @return true if it has to reach GL
+     */
+    bool changes(bool changed) {
+        changed ? issued_++ : elided_++;
+        return changed;
+    }
+
+    static constexpr GLuint kUnknown = ~0u;
+
+    GLuint program_;
+    GLuint vertexArray_;
+    GLuint framebuffer_;
+    GLuint activeUnit_;
+    std::array<GLuint, kTextureUnits> textures_;
+    std::array<int8_t, kCapabilityCount> enabled_;
+    GLenum depthFunc_;
+    int8_t depthMask_;
+    GLenum blendSource_;
+    GLenum blendDestination_;
+    std::array<GLint, 4> viewport_;
+
+    uint32_t elided_ = 0;
+    uint32_t issued_ = 0;
+    uint32_t lastElided_ = 0;
+    uint32_t lastIssued_ = 0;
+};
+
+/*!
+ * The state cache of the renderer's context. There's a single context, current on the render
+ * thread only.
+ */
+extern GLStateCache glState;
+
+#endif //ANDROIDGLINVESTIGATIONS_GLSTATECACHE_H
@@ -0,0 +1,232 @@
+#include "HZB.h"
+
+#include <algorithm>
+#include <random>
+
+#include "AndroidOut.h"
+#include "GLStateCache.h"
+#include "Utility.h"
+
+HZB::~HZB() {
+    if (texture_) {
+        glState.deleteTextures(1, &texture_);
+        texture_ = 0;
+    }
+}
+
+void HZB::setup(std::unique_ptr<Shader> buildShader, bool reverseZ) {
+    buildShader_ = std::move(buildShader);
+    reverseZ_ = reverseZ;
+    reverseZUniform_ = buildShader_->getUniform<bool>("reverseZ");
+    isFirstUniform_ = buildShader_->getUniform<bool>("isFirst");
+    mipCountUniform_ = buildShader_->getUniform<int>("mipCount");
+    inputSizeUniform_ = buildShader_->getUniform<glm::ivec2>("inputSize");
+    outputSizeUniform_ = buildShader_->getUniform<glm::ivec2>("outputSize");
+}
+
+void HZB::resize(int viewportWidth, int viewportHeight) {
+    if (viewportWidth == viewportWidth_ && viewportHeight == viewportHeight_) {
+        return;
+    }
+    if (texture_) {
+        glState.deleteTextures(1, &texture_);
+        texture_ = 0;
+    }
+
+    viewportWidth_ = viewportWidth;
+    viewportHeight_ = viewportHeight;
+    width_ = std::max(1, (viewportWidth + 1) / 2);
+    height_ = std::max(1, (viewportHeight + 1) / 2);
+    mipCount_ = 1;
+    while (getMipSize(mipCount_ - 1) != glm::ivec2(1, 1)) {
+        mipCount_++;
+    }
+
+    // GL halves mip sizes rounding down while the pyramid rounds up. Pad the storage until every
+    // GL level is at least as large as the pyramid level it holds; only the top left
+    // getMipSize(mip) texels of each level are valid.
+    int storageWidth = width_;
+    int storageHeight = height_;
+    for (int mip = 1; mip < mipCount_; mip++) {
+        auto size = getMipSize(mip);
+        storageWidth = std::max(storageWidth, size.x << mip);
+        storageHeight = std::max(storageHeight, size.y << mip);
+    }
+
+    glGenTextures(1, &texture_);
+    glState.bindTexture(0, GL_TEXTURE_2D, texture_);
+    glTexStorage2D(GL_TEXTURE_2D, mipCount_, GL_R32F, storageWidth, storageHeight);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, mipCount_ - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glState.bindTexture(0, GL_TEXTURE_2D, 0);
+}
+
+void HZB::build(GLuint depthTexture) {
+    buildShader_->activate();
+    buildShader_->Set(reverseZUniform_, reverseZ_);
+
+    glState.bindTexture(0, GL_TEXTURE_2D, depthTexture);
+
+    glm::ivec2 inputSize(viewportWidth_, viewportHeight_);
+    for (int firstMip = 0; firstMip < mipCount_; firstMip += kMipsPerDispatch) {
+        int batchMips = std::min(kMipsPerDispatch, mipCount_ - firstMip);
+        glm::ivec2 outputSize = getMipSize(firstMip);
+
+        buildShader_->Set(isFirstUniform_, firstMip == 0);
+        buildShader_->Set(mipCountUniform_, batchMips);
+        buildShader_->Set(inputSizeUniform_, inputSize);
+        buildShader_->Set(outputSizeUniform_, outputSize);
+        if (firstMip > 0) {
+            glBindImageTexture(4u, texture_, firstMip - 1, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+        }
+        for (int output = 0; output < kMipsPerDispatch; output++) {
+            // unused outputs of the last batch are never written, bind a valid level anyway
+            int mip = std::min(firstMip + output, mipCount_ - 1);
+            glBindImageTexture(output, texture_, mip, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+        }
+
+        glDispatchCompute((outputSize.x + kGroupTileSize - 1) / kGroupTileSize,
+                          (outputSize.y + kGroupTileSize - 1) / kGroupTileSize,
+                          1);
+
+        // the next batch image-loads this one; the barrier for the consumers of the pyramid is
+        // up to them
+        if (firstMip + kMipsPerDispatch < mipCount_) {
+            glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+        }
+
+        // the last mip of this batch is the parent of the next one
+        inputSize = getMipSize(firstMip + batchMips - 1);
+    }
+
+    buildShader_->deactivate();
+}
+
+std::vector<std::vector<float>> HZB::buildReference(
+        const std::vector<float> &depth,
+        int viewportWidth,
+        int viewportHeight,
+        bool reverseZ) {
+    auto furthest = [reverseZ](float a, float b) {
+        return reverseZ ? std::min(a, b) : std::max(a, b);
+    };
+
+    std::vector<std::vector<float>> mips;
+    const std::vector<float> *parent = &depth;
+    int parentWidth = viewportWidth;
+    int parentHeight = viewportHeight;
+    do {
+        int width = std::max(1, (parentWidth + 1) / 2);
+        int height = std::max(1, (parentHeight + 1) / 2);
+        std::vector<float> mip(width * height);
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                // clamp like the shader does for odd sized parents
+                int x0 = std::min(2 * x, parentWidth - 1);
+                int x1 = std::min(2 * x + 1, parentWidth - 1);
+                int y0 = std::min(2 * y, parentHeight - 1);
+                int y1 = std::min(2 * y + 1, parentHeight - 1);
+                const auto &p = *parent;
+                mip[y * width + x] = furthest(
+                        furthest(p[y0 * parentWidth + x0], p[y0 * parentWidth + x1]),
+                        furthest(p[y1 * parentWidth + x0], p[y1 * parentWidth + x1]));
+            }
+        }
+        mips.push_back(std::move(mip));
+        parent = &mips.back();
+        parentWidth = width;
+        parentHeight = height;
+    } while (parentWidth > 1 || parentHeight > 1);
+    return mips;
+}
+
+glm::ivec2 HZB::getMipSize(int mip) const {
+    // every level rounds up, so this is ceil(size / 2^mip)
+    return {(width_ + (1 << mip) - 1) >> mip, (height_ + (1 << mip) - 1) >> mip};
+}
+
+std::vector<float> HZB::readMip(int mip) const {
+    auto size = getMipSize(mip);
+    int width = size.x;
+    int height = size.y;
+
+    GLuint fbo;
+    glGenFramebuffers(1, &fbo);
+    glState.bindFramebuffer(fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture_, mip);
+
+    std::vector<float> rgba(width * height * 4);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_FLOAT, rgba.data());
+    glState.bindFramebuffer(0);
+    glState.deleteFramebuffers(1, &fbo);
+
+    std::vector<float> values(width * height);
+    for (size_t i = 0; i < values.size(); i++) {
+        values[i] = rgba[i * 4];
+    }
+    return values;
+}
+
+bool HZB::validate(std::unique_ptr<Shader> buildShader) {
+    if (!Utility::hasGlExtension("GL_EXT_color_buffer_float")) {
+        aout << "HZB validation skipped, R32F can't be read back" << std::endl;
+        return true;
+    }
+
+    // odd on both axes so every level has a ragged edge
+    constexpr int kWidth = 333;
+    constexpr int kHeight = 177;
+    std::vector<float> depth(kWidth * kHeight);
+    std::mt19937 random(42);
+    std::uniform_real_distribution<float> distribution(0.f, 1.f);
+    for (auto &value: depth) {
+        value = distribution(random);
+    }
+
+    GLuint depthTexture;
+    glGenTextures(1, &depthTexture);
+    glState.bindTexture(0, GL_TEXTURE_2D, depthTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, kWidth, kHeight, 0,
+                 GL_DEPTH_COMPONENT, GL_FLOAT, depth.data());
+    glState.bindTexture(0, GL_TEXTURE_2D, 0);
+
+    HZB hzb;
+    hzb.setup(std::move(buildShader), false);
+    bool valid = true;
+    for (bool reverseZ: {false, true}) {
+        hzb.reverseZ_ = reverseZ;
+        hzb.resize(kWidth, kHeight);
+        hzb.build(depthTexture);
+        glMemoryBarrier(GL_FRAMEBUFFER_BARRIER_BIT);
+
+        auto reference = buildReference(depth, kWidth, kHeight, reverseZ);
+        if (static_cast<int>(reference.size()) != hzb.mipCount_) {
+            aout << "[ERROR] HZB has " << hzb.mipCount_ << " mips, expected "
+                 << reference.size() << std::endl;
+            valid = false;
+            continue;
+        }
+        for (int mip = 0; mip < hzb.mipCount_; mip++) {
+            auto gpuMip = hzb.readMip(mip);
+            auto mismatch = std::mismatch(reference[mip].begin(), reference[mip].end(),
+                                          gpuMip.begin());
+            if (mismatch.first != reference[mip].end()) {
+                aout << "[ERROR] HZB mip " << mip << (reverseZ ? " (reverse-Z)" : "")
+                     << " differs at texel " << (mismatch.first - reference[mip].begin())
+                     << ": " << *mismatch.second << ", expected " << *mismatch.first
+                     << std::endl;
+                valid = false;
+            }
+        }
+    }
+    glState.deleteTextures(1, &depthTexture);
+
+    aout << "HZB validation " << (valid ? "passed" : "failed") << std::endl;
+    return valid;
+}
@@ -0,0 +1,123 @@
+#ifndef ANDROIDGLINVESTIGATIONS_HZB_H
+#define ANDROIDGLINVESTIGATIONS_HZB_H
+
+#include <GLES3/gl31.h>
+#include <memory>
+#include <vector>
+
+#include "Shader.h"
+
+/*!
+ * A hierarchical-Z pyramid holding the furthest depth of every region of the depth buffer. Mip 0
+ * is half the viewport (rounded up), every following mip halves again (rounded up) so each texel
+ * of mip n covers the 2^(n+1) x 2^(n+1) depth pixels starting at texel * 2^(n+1), including the
+ * ragged edges of non power of two viewports. The texture storage is padded so that those rounded
+ * up sizes fit into GL's rounded down mip chain; address it with texelFetch and texel coordinates.
+ *
+ * The pyramid is built by Shaders/hzb.comp, reducing up to four mips per dispatch through shared
+ * memory. "Furthest" is the max depth, or the min depth with reverse-Z.
+ */
+class HZB {
+public:
+    /*!
+     * Number of mips hzb.comp writes per dispatch
+     */
+    static constexpr int kMipsPerDispatch = 4;
+
+    /*!
+     * Size of the 2D workgroup tile of hzb.comp
+     */
+    static constexpr int kGroupTileSize = 8;
+
+    HZB() = default;
+
+    ~HZB();
+
+    HZB(const HZB &) = delete;
+
+    HZB &operator=(const HZB &) = delete;
+
+    /*!
+     * @param buildShader the hzb.comp program
+     * @param reverseZ true if the depth buffer is cleared to 0 and nearer is larger
+     */
+    void setup(std::unique_ptr<Shader> buildShader, bool reverseZ);
+
+    /*!
+     * @return true once setup handed over the build program
+     */
+    bool isReady() const { return buildShader_ != nullptr; }
+
+    /*!
+     * (Re)allocates the pyramid for a viewport. Does nothing if the size didn't change.
+     */
+    void resize(int viewportWidth, int viewportHeight);
+
+    /*!
+     * Builds every mip from a depth texture the size of the viewport. The texture must have
+     * nearest filtering. The caller issues the barrier for whatever reads the result, the render
+     * graph derives it from the pass' ImageStore access.
+     */
+    void build(GLuint depthTexture);
+
+    GLuint getTexture() const { return texture_; }
+
+    int getWidth() const { return width_; }
+
+    int getHeight() const { return height_; }
+
+    int getMipCount() const { return mipCount_; }
+
+    /*!
+     * @return the size of the depth buffer the pyramid was built for
+     */
+    glm::ivec2 getViewportSize() const { return {viewportWidth_, viewportHeight_}; }
+
+    /*!
+     * @return the size of a mip, ceil(size of mip 0 / 2^mip)
+     */
+    glm::ivec2 getMipSize(int mip) const;
+
+    bool isReverseZ() const { return reverseZ_; }
+
+    /*!
+     * CPU implementation of the same reduction, used to validate the GPU pyramid
+     * @param depth viewportWidth * viewportHeight depth values, row major
+     * @return every mip, row major, mip 0 first
+     */
+    static std::vector<std::vector<float>> buildReference(
+            const std::vector<float> &depth,
+            int viewportWidth,
+            int viewportHeight,
+            bool reverseZ);
+
+    /*!
+     * Builds a pyramid from a random depth texture of an awkward size on the GPU and compares every
+     * mip with @a buildReference. Requires EXT_color_buffer_float to read the mips back.
+     * @return true if all mips match
+     */
+    static bool validate(std::unique_ptr<Shader> buildShader);
+
+private:
+    /*!
+     * Reads one mip back through a temporary framebuffer
+     */
+    std::vector<float> readMip(int mip) const;
+
+    std::unique_ptr<Shader> buildShader_;
+    UniformHandle<bool> reverseZUniform_;
+    UniformHandle<bool> isFirstUniform_;
+    UniformHandle<int> mipCountUniform_;
+    UniformHandle<glm::ivec2> inputSizeUniform_;
+    UniformHandle<glm::ivec2> outputSizeUniform_;
+    bool reverseZ_ = false;
+
+    GLuint texture_ = 0;
+    int viewportWidth_ = 0;
+    int viewportHeight_ = 0;
+    int width_ = 0;
+    int height_ = 0;
+    int mipCount_ = 0;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_HZB_H
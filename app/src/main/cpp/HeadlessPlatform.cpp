@@ -0,0 +1,98 @@
+#include "HeadlessPlatform.h"
+
+#include <EGL/eglext.h>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "AndroidOut.h"
+
+bool FileAssetProvider::readAsset(const std::string &assetPath, std::vector<uint8_t> &outData) {
+    std::ifstream file(rootDir_ + "/" + assetPath, std::ios::binary | std::ios::ate);
+    if (!file) {
+        aout << "[ERROR] Failed to open asset " << assetPath << std::endl;
+        return false;
+    }
+    auto length = static_cast<size_t>(file.tellg());
+    file.seekg(0);
+    outData.resize(length);
+    return static_cast<bool>(file.read(reinterpret_cast<char *>(outData.data()), length));
+}
+
+/*!
+ * Unmaps the file when it goes away. The descriptor is closed right after mapping, the mapping
+ * keeps the file alive.
+ */
+class FileMapping : public AssetMapping {
+public:
+    FileMapping(void *address, size_t size) {
+        data_ = static_cast<const uint8_t *>(address);
+        size_ = size;
+    }
+
+    ~FileMapping() override {
+        if (size_ > 0) {
+            munmap(const_cast<uint8_t *>(data_), size_);
+        }
+    }
+};
+
+std::unique_ptr<AssetMapping> FileAssetProvider::mapAsset(const std::string &assetPath) {
+    int fd = open((rootDir_ + "/" + assetPath).c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return nullptr;
+    }
+    struct stat info{};
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        return nullptr;
+    }
+    // mmap refuses empty files
+    void *address = nullptr;
+    auto size = static_cast<size_t>(info.st_size);
+    if (size > 0) {
+        address = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (address == MAP_FAILED) {
+        aout << "[ERROR] Failed to map asset " << assetPath << std::endl;
+        return nullptr;
+    }
+    return std::make_unique<FileMapping>(address, size);
+}
+
+HeadlessPlatform::HeadlessPlatform(std::string assetDir, EGLint width, EGLint height,
+                                   std::string cacheDir) :
+        assets_(std::move(assetDir)),
+        width_(width),
+        height_(height),
+        cacheDir_(std::move(cacheDir)) {}
+
+EGLDisplay HeadlessPlatform::getDisplay() {
+    // Client extensions are queried without a display
+    auto clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+            eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if (clientExtensions && getPlatformDisplay
+        && strstr(clientExtensions, "EGL_MESA_platform_surfaceless")) {
+        aout << "Using the surfaceless EGL platform" << std::endl;
+        return getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    }
+    return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+EGLint HeadlessPlatform::getSurfaceType() const {
+    return EGL_PBUFFER_BIT;
+}
+
+EGLSurface HeadlessPlatform::createSurface(EGLDisplay display, EGLConfig config) {
+    const EGLint attribs[] = {
+            EGL_WIDTH, width_,
+            EGL_HEIGHT, height_,
+            EGL_NONE
+    };
+    return eglCreatePbufferSurface(display, config, attribs);
+}
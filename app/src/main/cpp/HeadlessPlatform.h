@@ -0,0 +1,58 @@
+#ifndef ANDROIDGLINVESTIGATIONS_HEADLESSPLATFORM_H
+#define ANDROIDGLINVESTIGATIONS_HEADLESSPLATFORM_H
+
+#include "Platform.h"
+
+/*!
+ * Reads assets from a directory on the filesystem, usually app/src/main/assets of the checkout
+ */
+class FileAssetProvider : public AssetProvider {
+public:
+    inline FileAssetProvider(std::string rootDir) : rootDir_(std::move(rootDir)) {}
+
+    bool readAsset(const std::string &assetPath, std::vector<uint8_t> &outData) override;
+
+    /*!
+     * mmaps the file read-only
+     */
+    std::unique_ptr<AssetMapping> mapAsset(const std::string &assetPath) override;
+
+private:
+    std::string rootDir_;
+};
+
+/*!
+ * A Platform without a window. Renders into an EGL pbuffer of a fixed size, using the Mesa
+ * surfaceless platform when the EGL implementation offers it so no X or Wayland server is needed.
+ * There is no input source.
+ */
+class HeadlessPlatform : public Platform {
+public:
+    /*!
+     * @param assetDir the directory to read assets from
+     * @param width the width of the pbuffer
+     * @param height the height of the pbuffer
+     * @param cacheDir the directory for cached data, empty to cache nothing
+     */
+    HeadlessPlatform(std::string assetDir, EGLint width, EGLint height, std::string cacheDir = "");
+
+    EGLDisplay getDisplay() override;
+
+    EGLint getSurfaceType() const override;
+
+    EGLSurface createSurface(EGLDisplay display, EGLConfig config) override;
+
+    AssetProvider &getAssets() override { return assets_; }
+
+    std::string getCacheDir() const override { return cacheDir_; }
+
+    void pollInput(InputEvents &/*outEvents*/) override {}
+
+private:
+    FileAssetProvider assets_;
+    EGLint width_;
+    EGLint height_;
+    std::string cacheDir_;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_HEADLESSPLATFORM_H
@@ -0,0 +1,170 @@
+#include "JobSystem.h"
+
+JobSystem jobSystem;
+
+/*!
+ * The scheduler the calling thread works for and its index there, nullptr and -1 if it isn't a
+ * worker
+ */
+static thread_local JobSystem *tlsSystem = nullptr;
+static thread_local int tlsWorker = -1;
+
+void JobSystem::start(unsigned workerCount) {
+    if (!workers_.empty()) {
+        return;
+    }
+    for (unsigned i = 0; i < workerCount; i++) {
+        workers_.push_back(std::make_unique<Worker>());
+    }
+    // every deque exists before the first worker looks for something to steal
+    for (unsigned i = 0; i < workerCount; i++) {
+        workers_[i]->thread = std::thread(&JobSystem::workerMain, this, int(i));
+    }
+}
+
+void JobSystem::stop() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        if (workers_.empty()) {
+            return;
+        }
+        stopping_ = true;
+    }
+    workQueued_.notify_all();
+    for (auto &worker: workers_) {
+        worker->thread.join();
+    }
+    workers_.clear();
+    stopping_ = false;
+}
+
+void JobSystem::run(Job job, Counter *counter) {
+    if (counter) {
+        counter->count_.fetch_add(1, std::memory_order_relaxed);
+    }
+    push({std::move(job), counter});
+}
+
+void JobSystem::runAfter(Counter &dependency, Job job, Counter *counter) {
+    if (counter) {
+        counter->count_.fetch_add(1, std::memory_order_relaxed);
+    }
+    {
+        // finish() decrements under the same lock, so the count can't reach zero in between
+        std::lock_guard<std::mutex> lock(dependency.mutex_);
+        if (dependency.count_.load(std::memory_order_acquire) != 0) {
+            dependency.continuations_.push_back({std::move(job), counter});
+            return;
+        }
+    }
+    push({std::move(job), counter});
+}
+
+void JobSystem::wait(Counter &counter) {
+    int self = tlsSystem == this ? tlsWorker : -1;
+    while (!counter.isDone()) {
+        Task task;
+        if (pop(self, task)) {
+            execute(task);
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    // the job that finished last may still hold the lock, the counter must not go away before
+    std::lock_guard<std::mutex> lock(counter.mutex_);
+}
+
+void JobSystem::push(Task task) {
+    if (workers_.empty()) {
+        execute(task);
+        return;
+    }
+    size_t index = tlsSystem == this
+                   ? size_t(tlsWorker)
+                   : nextWorker_.fetch_add(1, std::memory_order_relaxed) % workers_.size();
+    {
+        std::lock_guard<std::mutex> lock(workers_[index]->mutex);
+        workers_[index]->tasks.push_back(std::move(task));
+    }
+    queuedCount_.fetch_add(1, std::memory_order_release);
+    {
+        // a worker checks queuedCount_ under this lock before it sleeps, taking it here means the
+        // notification can't slip in between
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+    }
+    workQueued_.notify_one();
+}
+
+bool JobSystem::pop(int self, Task &outTask) {
+    if (queuedCount_.load(std::memory_order_acquire) == 0) {
+        return false;
+    }
+    if (self >= 0) {
+        auto &worker = *workers_[self];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if (!worker.tasks.empty()) {
+            outTask = std::move(worker.tasks.back());
+            worker.tasks.pop_back();
+            queuedCount_.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    size_t count = workers_.size();
+    size_t first = self >= 0 ? size_t(self) + 1 : nextWorker_.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < count; i++) {
+        size_t victim = (first + i) % count;
+        if (int(victim) == self) {
+            continue;
+        }
+        auto &worker = *workers_[victim];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if (!worker.tasks.empty()) {
+            outTask = std::move(worker.tasks.front());
+            worker.tasks.pop_front();
+            queuedCount_.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+void JobSystem::execute(Task &task) {
+    task.job();
+    if (task.counter) {
+        finish(*task.counter);
+    }
+}
+
+void JobSystem::finish(Counter &counter) {
+    std::vector<Counter::Continuation> ready;
+    {
+        std::lock_guard<std::mutex> lock(counter.mutex_);
+        if (counter.count_.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+            return;
+        }
+        ready.swap(counter.continuations_);
+    }
+    // the counter may be gone now, only what was taken out of it is left to touch
+    for (auto &continuation: ready) {
+        push({std::move(continuation.job), continuation.counter});
+    }
+}
+
+void JobSystem::workerMain(int index) {
+    tlsSystem = this;
+    tlsWorker = index;
+    while (true) {
+        Task task;
+        if (pop(index, task)) {
+            execute(task);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex_);
+        workQueued_.wait(lock, [this] {
+            return stopping_ || queuedCount_.load(std::memory_order_acquire) > 0;
+        });
+        if (stopping_ && queuedCount_.load(std::memory_order_acquire) == 0) {
+            return;
+        }
+    }
+}
@@ -0,0 +1,163 @@
+#ifndef ANDROIDGLINVESTIGATIONS_JOBSYSTEM_H
+#define ANDROIDGLINVESTIGATIONS_JOBSYSTEM_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*!
+ * Work-stealing scheduler for short CPU jobs: culling, sorting, mesh processing and the like.
+ *
+ * Every worker has its own deque. A worker pushes and pops at the back, so nested jobs run while
+ * their data is still in cache. An idle worker steals from the front of another worker's deque,
+ * which holds the oldest and usually biggest jobs. Threads that aren't workers, such as the render
+ * thread or the asset loader's, spread their jobs over the workers round robin.
+ *
+ * A thread waiting for a Counter runs queued jobs until it reaches zero, so jobs may submit and
+ * wait for jobs of their own. Jobs must not block on anything else, or they hold up a worker.
+ *
+ * Without workers, before @a start or after @a stop, every job runs inline when submitted.
+ */
+class JobSystem {
+public:
+    using Job = std::function<void()>;
+
+    /*!
+     * Counts the unfinished jobs submitted with it. Jobs submitted with @a runAfter start once it
+     * drops to zero. Must outlive its jobs.
+     */
+    class Counter {
+    public:
+        Counter() = default;
+
+        Counter(const Counter &) = delete;
+
+        Counter &operator=(const Counter &) = delete;
+
+        bool isDone() const { return count_.load(std::memory_order_acquire) == 0; }
+
+    private:
+        friend class JobSystem;
+
+        struct Continuation {
+            Job job;
+            Counter *counter;
+        };
+
+        std::atomic<int> count_{0};
+        std::mutex mutex_;
+        std::vector<Continuation> continuations_;
+    };
+
+    JobSystem() = default;
+
+    ~JobSystem() { stop(); }
+
+    JobSystem(const JobSystem &) = delete;
+
+    JobSystem &operator=(const JobSystem &) = delete;
+
+    /*!
+     * Starts @a workerCount workers, does nothing if they're running already
+     */
+    void start(unsigned workerCount);
+
+    /*!
+     * Runs what's queued and joins the workers
+     */
+    void stop();
+
+    unsigned getWorkerCount() const { return static_cast<unsigned>(workers_.size()); }
+
+    /*!
+     * Queues @a job
+     * @param counter incremented now and decremented when the job is done, may be nullptr
+     */
+    void run(Job job, Counter *counter = nullptr);
+
+    /*!
+     * Queues @a job once @a dependency has dropped to zero, right away if it's zero already
+     */
+    void runAfter(Counter &dependency, Job job, Counter *counter = nullptr);
+
+    /*!
+     * Runs queued jobs until @a counter drops to zero
+     */
+    void wait(Counter &counter);
+
+    /*!
+     * Calls @a function(rangeBegin, rangeEnd) over [begin, end) in ranges of @a grain elements,
+     * in parallel, and returns when all of them are done. The calling thread runs one range itself.
+     * Ranges are disjoint but run in no particular order.
+     */
+    template<typename Function>
+    void parallelFor(size_t begin, size_t end, size_t grain, const Function &function) {
+        grain = std::max<size_t>(grain, 1);
+        if (end - begin <= grain || workers_.empty()) {
+            if (begin < end) {
+                function(begin, end);
+            }
+            return;
+        }
+        Counter counter;
+        size_t rangeBegin = begin;
+        for (; end - rangeBegin > grain; rangeBegin += grain) {
+            size_t rangeEnd = rangeBegin + grain;
+            run([&function, rangeBegin, rangeEnd] { function(rangeBegin, rangeEnd); }, &counter);
+        }
+        function(rangeBegin, end);
+        wait(counter);
+    }
+
+private:
+    struct Task {
+        Job job;
+        Counter *counter;
+    };
+
+    /*!
+     * The deque of one worker. A mutex is cheap next to jobs worth scheduling, and unlike a
+     * lock-free deque it needs no reasoning about memory ordering.
+     */
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+        std::thread thread;
+    };
+
+    void push(Task task);
+
+    /*!
+     * Pops from the back of @a self's deque, else steals from the front of the others'
+     * @param self the worker index of the calling thread, -1 if it isn't a worker
+     */
+    bool pop(int self, Task &outTask);
+
+    void execute(Task &task);
+
+    void finish(Counter &counter);
+
+    void workerMain(int index);
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::atomic<unsigned> nextWorker_{0};
+
+    std::mutex sleepMutex_;
+    std::condition_variable workQueued_;
+    std::atomic<int> queuedCount_{0};
+    bool stopping_ = false;
+};
+
+/*!
+ * The engine's scheduler. The renderer starts it, any code can submit to it.
+ */
+extern JobSystem jobSystem;
+
+#endif //ANDROIDGLINVESTIGATIONS_JOBSYSTEM_H
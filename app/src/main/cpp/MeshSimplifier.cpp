@@ -0,0 +1,326 @@
+#include "MeshSimplifier.h"
+
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+namespace
+{
+struct FPositionKey
+{
+    uint32_t bits[3];
+
+    bool operator==(const FPositionKey& other) const
+    {
+        return bits[0] == other.bits[0] && bits[1] == other.bits[1] && bits[2] == other.bits[2];
+    }
+};
+
+struct FPositionHash
+{
+    size_t operator()(const FPositionKey& key) const
+    {
+        return (key.bits[0] * 73856093u) ^ (key.bits[1] * 19349663u) ^ (key.bits[2] * 83492791u);
+    }
+};
+
+uint64_t EdgeKey(uint32_t a, uint32_t b)
+{
+    return a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a;
+}
+}
+
+FMeshSimplifier::FQuadric FMeshSimplifier::FQuadric::FromPlane(const glm::dvec3& normal, double distance, double weight)
+{
+    double a = normal.x, b = normal.y, c = normal.z, d = distance;
+    FQuadric quadric;
+    quadric.m = {a * a, a * b, a * c, a * d,
+                 b * b, b * c, b * d,
+                 c * c, c * d,
+                 d * d};
+    for (auto& value : quadric.m)
+    {
+        value *= weight;
+    }
+    return quadric;
+}
+
+FMeshSimplifier::FQuadric& FMeshSimplifier::FQuadric::operator+=(const FQuadric& other)
+{
+    for (size_t i = 0; i < m.size(); i++)
+    {
+        m[i] += other.m[i];
+    }
+    return *this;
+}
+
+double FMeshSimplifier::FQuadric::Evaluate(const glm::dvec3& p) const
+{
+    // v^T Q v with v = (p, 1)
+    return m[0] * p.x * p.x + 2.0 * m[1] * p.x * p.y + 2.0 * m[2] * p.x * p.z + 2.0 * m[3] * p.x
+           + m[4] * p.y * p.y + 2.0 * m[5] * p.y * p.z + 2.0 * m[6] * p.y
+           + m[7] * p.z * p.z + 2.0 * m[8] * p.z
+           + m[9];
+}
+
+FMeshSimplifier::FMeshSimplifier(const std::vector<glm::vec3>& positions, const std::vector<glm::vec3>& normals,
+                                 const std::vector<glm::vec2>& uvs, const std::vector<uint32_t>& indices)
+    : mNormals(normals), mUvs(uvs)
+{
+    std::unordered_map<FPositionKey, uint32_t, FPositionHash> welded;
+    mWelded.resize(positions.size());
+    for (size_t i = 0; i < positions.size(); i++)
+    {
+        FPositionKey key;
+        std::memcpy(key.bits, &positions[i], sizeof(key.bits));
+        auto [it, inserted] = welded.emplace(key, static_cast<uint32_t>(mPositions.size()));
+        if (inserted)
+        {
+            mPositions.push_back(positions[i]);
+            mOriginalVertices.emplace_back();
+            mSeams.push_back(0);
+        }
+        uint32_t position = it->second;
+        auto& originals = mOriginalVertices[position];
+        if (!originals.empty() && (normals[i] != normals[originals[0]] || uvs[i] != uvs[originals[0]]))
+        {
+            mSeams[position] = 1;
+        }
+        originals.push_back(static_cast<uint32_t>(i));
+        mWelded[i] = position;
+    }
+    mQuadrics.resize(mPositions.size());
+    mVersions.resize(mPositions.size(), 0);
+    mRemoved.resize(mPositions.size(), 0);
+    mVertexTriangles.resize(mPositions.size());
+
+    std::unordered_map<uint64_t, int> edgeUses;
+    for (size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        std::array<uint32_t, 3> corners = {mWelded[indices[i]], mWelded[indices[i + 1]], mWelded[indices[i + 2]]};
+        if (corners[0] == corners[1] || corners[1] == corners[2] || corners[2] == corners[0])
+        {
+            continue;
+        }
+        auto triangle = static_cast<uint32_t>(mTriangles.size());
+        mTriangles.push_back(corners);
+        mOriginalTriangles.push_back({indices[i], indices[i + 1], indices[i + 2]});
+        for (int k = 0; k < 3; k++)
+        {
+            mVertexTriangles[corners[k]].push_back(triangle);
+            edgeUses[EdgeKey(corners[k], corners[(k + 1) % 3])]++;
+        }
+    }
+    mTriangleRemoved.resize(mTriangles.size(), 0);
+    mLiveTriangles = mTriangles.size();
+
+    for (const auto& corners : mTriangles)
+    {
+        glm::dvec3 p0 = mPositions[corners[0]], p1 = mPositions[corners[1]], p2 = mPositions[corners[2]];
+        glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+        double length = glm::length(normal);
+        if (length <= 0.0)
+        {
+            continue;
+        }
+        normal /= length;
+        FQuadric plane = FQuadric::FromPlane(normal, -glm::dot(normal, p0), 1.0);
+        for (uint32_t corner : corners)
+        {
+            mQuadrics[corner] += plane;
+        }
+        for (int k = 0; k < 3; k++)
+        {
+            uint32_t a = corners[k], b = corners[(k + 1) % 3];
+            if (edgeUses[EdgeKey(a, b)] != 1)
+            {
+                continue;
+            }
+            glm::dvec3 edge = glm::dvec3(mPositions[b]) - glm::dvec3(mPositions[a]);
+            glm::dvec3 borderNormal = glm::cross(edge, normal);
+            double borderLength = glm::length(borderNormal);
+            if (borderLength <= 0.0)
+            {
+                continue;
+            }
+            borderNormal /= borderLength;
+            FQuadric border = FQuadric::FromPlane(borderNormal, -glm::dot(borderNormal, glm::dvec3(mPositions[a])), kBorderWeight);
+            mQuadrics[a] += border;
+            mQuadrics[b] += border;
+        }
+    }
+
+    for (const auto& corners : mTriangles)
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            PushCollapse(corners[k], corners[(k + 1) % 3]);
+            PushCollapse(corners[(k + 1) % 3], corners[k]);
+        }
+    }
+}
+
+std::vector<uint32_t> FMeshSimplifier::Simplify(size_t targetTriangles, float maxError)
+{
+    double maxCost = double(maxError) * double(maxError);
+    while (mLiveTriangles > targetTriangles && !mQueue.empty())
+    {
+        FCollapse collapse = mQueue.top();
+        if (mRemoved[collapse.from] || mRemoved[collapse.to]
+            || mVersions[collapse.from] != collapse.fromVersion || mVersions[collapse.to] != collapse.toVersion)
+        {
+            // outdated, the vertices that changed queued their edges again
+            mQueue.pop();
+            continue;
+        }
+        if (collapse.error > maxCost)
+        {
+            break;
+        }
+        mQueue.pop();
+        if (!IsValid(collapse.from, collapse.to))
+        {
+            continue;
+        }
+        Collapse(collapse.from, collapse.to);
+        mError = std::max(mError, float(std::sqrt(std::max(collapse.error, 0.0))));
+    }
+
+    std::vector<uint32_t> result;
+    result.reserve(mLiveTriangles * 3);
+    for (size_t t = 0; t < mTriangles.size(); t++)
+    {
+        if (mTriangleRemoved[t])
+        {
+            continue;
+        }
+        for (int k = 0; k < 3; k++)
+        {
+            // a corner keeps its own vertex, and so its attributes, as long as it didn't move
+            uint32_t original = mOriginalTriangles[t][k];
+            result.push_back(mWelded[original] == mTriangles[t][k] ? original : FindVertex(mTriangles[t][k], original));
+        }
+    }
+    return result;
+}
+
+void FMeshSimplifier::PushCollapse(uint32_t from, uint32_t to)
+{
+    if (mSeams[from])
+    {
+        // moving a seam would pull the vertices of one side over the triangles of the other
+        return;
+    }
+    FQuadric quadric = mQuadrics[from];
+    quadric += mQuadrics[to];
+    double error = quadric.Evaluate(mPositions[to]);
+    glm::dvec3 edge = glm::dvec3(mPositions[to]) - glm::dvec3(mPositions[from]);
+    double cost = error + kEdgeLengthWeight * glm::dot(edge, edge);
+    mQueue.push({cost, error, from, to, mVersions[from], mVersions[to]});
+}
+
+bool FMeshSimplifier::IsValid(uint32_t from, uint32_t to) const
+{
+    glm::vec3 target = mPositions[to];
+    for (uint32_t triangle : mVertexTriangles[from])
+    {
+        const auto& corners = mTriangles[triangle];
+        if (mTriangleRemoved[triangle] || corners[0] == to || corners[1] == to || corners[2] == to)
+        {
+            continue;
+        }
+        glm::vec3 p[3], moved[3];
+        for (int k = 0; k < 3; k++)
+        {
+            p[k] = mPositions[corners[k]];
+            moved[k] = corners[k] == from ? target : p[k];
+        }
+        glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+        glm::vec3 after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+        float beforeLength = glm::length(before);
+        float afterLength = glm::length(after);
+        if (afterLength <= 0.0f || (beforeLength > 0.0f && glm::dot(before, after) < kMinNormalDot * beforeLength * afterLength))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void FMeshSimplifier::Collapse(uint32_t from, uint32_t to)
+{
+    for (uint32_t triangle : mVertexTriangles[from])
+    {
+        if (mTriangleRemoved[triangle])
+        {
+            continue;
+        }
+        auto& corners = mTriangles[triangle];
+        if (corners[0] == to || corners[1] == to || corners[2] == to)
+        {
+            // the collapsed edge's triangles degenerate
+            mTriangleRemoved[triangle] = 1;
+            mLiveTriangles--;
+            continue;
+        }
+        for (auto& corner : corners)
+        {
+            if (corner == from)
+            {
+                corner = to;
+            }
+        }
+        mVertexTriangles[to].push_back(triangle);
+    }
+    mQuadrics[to] += mQuadrics[from];
+    mRemoved[from] = 1;
+    std::vector<uint32_t>().swap(mVertexTriangles[from]);
+    mVersions[to]++;
+
+    // every edge around the kept vertex costs something else now, the new version drops the
+    // queued ones
+    auto& triangles = mVertexTriangles[to];
+    size_t live = 0;
+    for (uint32_t triangle : triangles)
+    {
+        if (!mTriangleRemoved[triangle])
+        {
+            triangles[live++] = triangle;
+        }
+    }
+    triangles.resize(live);
+    for (uint32_t triangle : triangles)
+    {
+        for (uint32_t corner : mTriangles[triangle])
+        {
+            if (corner != to)
+            {
+                PushCollapse(to, corner);
+                PushCollapse(corner, to);
+            }
+        }
+    }
+}
+
+uint32_t FMeshSimplifier::FindVertex(uint32_t position, uint32_t original) const
+{
+    const auto& originals = mOriginalVertices[position];
+    if (!mSeams[position])
+    {
+        return originals[0];
+    }
+    uint32_t best = originals[0];
+    float bestDistance = INFINITY;
+    for (uint32_t vertex : originals)
+    {
+        glm::vec3 normal = mNormals[vertex] - mNormals[original];
+        glm::vec2 uv = mUvs[vertex] - mUvs[original];
+        float distance = glm::dot(normal, normal) + glm::dot(uv, uv);
+        if (distance < bestDistance)
+        {
+            best = vertex;
+            bestDistance = distance;
+        }
+    }
+    return best;
+}
@@ -0,0 +1,125 @@
+#ifndef ANDROIDGLINVESTIGATIONS_MESHSIMPLIFIER_H
+#define ANDROIDGLINVESTIGATIONS_MESHSIMPLIFIER_H
+
+#include <array>
+#include <cstdint>
+#include <queue>
+#include <vector>
+#include <glm/glm.hpp>
+
+/*!
+ * Quadric error mesh simplification (Garland/Heckbert) by half-edge collapses. Every vertex
+ * accumulates the planes of its triangles, collapsing an edge onto one of its vertices costs the
+ * summed squared distance of that vertex to the planes of both. Open borders add planes at right
+ * angles to their triangles, so they hold their shape.
+ *
+ * Vertices are welded by position first, importers split them at uv and normal seams. A collapse
+ * only ever moves a vertex onto an existing one, so the result indexes the original vertices and
+ * the LODs share one vertex buffer. Seams stay where they are: a position whose vertices differ in
+ * normal or uv never moves, and a corner moved onto one takes the vertex from its own side.
+ *
+ * Simplify() continues from where the last call stopped, calling it with decreasing targets builds
+ * a LOD chain in one pass.
+ */
+class FMeshSimplifier
+{
+public:
+    FMeshSimplifier(const std::vector<glm::vec3>& positions, const std::vector<glm::vec3>& normals,
+                    const std::vector<glm::vec2>& uvs, const std::vector<uint32_t>& indices);
+
+    /*!
+     * Collapses edges, cheapest first, until at most @a targetTriangles are left or the cheapest
+     * collapse would move the surface further than @a maxError
+     * @return the triangles left, indexing the original vertices
+     */
+    std::vector<uint32_t> Simplify(size_t targetTriangles, float maxError);
+
+    size_t GetTriangleCount() const { return mLiveTriangles; }
+
+    /*!
+     * @return roughly how far the surface moved, the largest collapse error so far
+     */
+    float GetError() const { return mError; }
+
+private:
+    /*!
+     * Symmetric 4x4 matrix of the summed plane equations, its upper triangle
+     */
+    struct FQuadric
+    {
+        std::array<double, 10> m{};
+
+        static FQuadric FromPlane(const glm::dvec3& normal, double distance, double weight);
+
+        FQuadric& operator+=(const FQuadric& other);
+
+        double Evaluate(const glm::dvec3& point) const;
+    };
+
+    struct FCollapse
+    {
+        /*!
+         * The quadric error, plus a little for the edge length to order collapses of equal error
+         */
+        double cost;
+        double error;
+        uint32_t from;
+        uint32_t to;
+        uint32_t fromVersion;
+        uint32_t toVersion;
+
+        bool operator>(const FCollapse& other) const { return cost > other.cost; }
+    };
+
+    void PushCollapse(uint32_t from, uint32_t to);
+
+    bool IsValid(uint32_t from, uint32_t to) const;
+
+    void Collapse(uint32_t from, uint32_t to);
+
+    /*!
+     * @return the vertex at welded @a position closest in normal and uv to @a original, the
+     * vertex a moved corner takes
+     */
+    uint32_t FindVertex(uint32_t position, uint32_t original) const;
+
+    /*!
+     * Triangles whose normal turns further than this (cosine) by a collapse reject it
+     */
+    static constexpr float kMinNormalDot = 0.2f;
+    /*!
+     * Weight of the border planes relative to the triangle planes
+     */
+    static constexpr double kBorderWeight = 10.0;
+    /*!
+     * Weight of the squared edge length in the cost. On flat regions every collapse is free, short
+     * edges first keeps them from all piling onto one vertex.
+     */
+    static constexpr double kEdgeLengthWeight = 1e-3;
+
+    // welded vertices
+    std::vector<glm::vec3> mPositions;
+    std::vector<FQuadric> mQuadrics;
+    std::vector<uint32_t> mVersions;
+    std::vector<uint8_t> mRemoved;
+    std::vector<std::vector<uint32_t>> mVertexTriangles;
+    // the original vertices at a welded one, seams where their attributes differ
+    std::vector<std::vector<uint32_t>> mOriginalVertices;
+    std::vector<uint8_t> mSeams;
+
+    // original vertices
+    std::vector<uint32_t> mWelded;
+    std::vector<glm::vec3> mNormals;
+    std::vector<glm::vec2> mUvs;
+
+    // per triangle the welded corners as they are now and the original ones
+    std::vector<std::array<uint32_t, 3>> mTriangles;
+    std::vector<std::array<uint32_t, 3>> mOriginalTriangles;
+    std::vector<uint8_t> mTriangleRemoved;
+    size_t mLiveTriangles = 0;
+
+    std::priority_queue<FCollapse, std::vector<FCollapse>, std::greater<FCollapse>> mQueue;
+    float mError = 0.0f;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_MESHSIMPLIFIER_H
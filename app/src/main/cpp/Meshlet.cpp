@@ -0,0 +1,272 @@
+#include "Meshlet.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+
+namespace
+{
+constexpr uint32_t kNone = std::numeric_limits<uint32_t>::max();
+
+struct FPositionKey
+{
+    uint32_t bits[3];
+
+    bool operator==(const FPositionKey& other) const
+    {
+        return bits[0] == other.bits[0] && bits[1] == other.bits[1] && bits[2] == other.bits[2];
+    }
+};
+
+struct FPositionHash
+{
+    size_t operator()(const FPositionKey& key) const
+    {
+        return (key.bits[0] * 73856093u) ^ (key.bits[1] * 19349663u) ^ (key.bits[2] * 83492791u);
+    }
+};
+
+// spreads the low 10 bits of v over every third bit
+uint32_t SpreadBits(uint32_t v)
+{
+    v = (v | (v << 16)) & 0x030000FFu;
+    v = (v | (v << 8)) & 0x0300F00Fu;
+    v = (v | (v << 4)) & 0x030C30C3u;
+    v = (v | (v << 2)) & 0x09249249u;
+    return v;
+}
+}
+
+std::vector<FMeshlet> FMeshletBuilder::Build(const std::vector<glm::vec3>& positions, std::vector<uint32_t>& inOutIndices)
+{
+    size_t triangleCount = inOutIndices.size() / 3;
+
+    // neighbours are found through vertices welded by position, importers split them at uv and
+    // normal seams or don't share them at all
+    std::unordered_map<FPositionKey, uint32_t, FPositionHash> positionIds;
+    std::vector<uint32_t> welded(positions.size());
+    for (size_t v = 0; v < positions.size(); v++)
+    {
+        FPositionKey key;
+        std::memcpy(key.bits, &positions[v], sizeof(key.bits));
+        welded[v] = positionIds.emplace(key, static_cast<uint32_t>(positionIds.size())).first->second;
+    }
+
+    // the triangles around every welded vertex, as one list with an offset per vertex
+    std::vector<uint32_t> vertexOffsets(positionIds.size() + 1, 0);
+    for (size_t i = 0; i < triangleCount * 3; i++)
+    {
+        vertexOffsets[welded[inOutIndices[i]] + 1]++;
+    }
+    for (size_t v = 0; v < positionIds.size(); v++)
+    {
+        vertexOffsets[v + 1] += vertexOffsets[v];
+    }
+    std::vector<uint32_t> vertexTriangles(triangleCount * 3);
+    std::vector<uint32_t> cursors(vertexOffsets.begin(), vertexOffsets.end() - 1);
+    for (size_t i = 0; i < triangleCount * 3; i++)
+    {
+        vertexTriangles[cursors[welded[inOutIndices[i]]]++] = static_cast<uint32_t>(i / 3);
+    }
+
+    std::vector<glm::vec3> centroids(triangleCount);
+    glm::vec3 boundsMin(std::numeric_limits<float>::max());
+    glm::vec3 boundsMax(std::numeric_limits<float>::lowest());
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        centroids[t] = (positions[inOutIndices[t * 3]] + positions[inOutIndices[t * 3 + 1]]
+                        + positions[inOutIndices[t * 3 + 2]]) / 3.0f;
+        boundsMin = glm::min(boundsMin, centroids[t]);
+        boundsMax = glm::max(boundsMax, centroids[t]);
+    }
+
+    // seeds go in Morton order of the centroids, so a meshlet that runs out of neighbours, on
+    // unwelded or scattered geometry, continues with the triangles nearby
+    std::vector<uint32_t> mortonCodes(triangleCount);
+    glm::vec3 scale = 1023.0f / glm::max(boundsMax - boundsMin, glm::vec3(1e-20f));
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        glm::uvec3 cell = glm::uvec3(glm::clamp((centroids[t] - boundsMin) * scale, 0.0f, 1023.0f));
+        mortonCodes[t] = SpreadBits(cell.x) | (SpreadBits(cell.y) << 1) | (SpreadBits(cell.z) << 2);
+    }
+    std::vector<uint32_t> seedOrder(triangleCount);
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        seedOrder[t] = static_cast<uint32_t>(t);
+    }
+    std::stable_sort(seedOrder.begin(), seedOrder.end(),
+                     [&mortonCodes](uint32_t a, uint32_t b) { return mortonCodes[a] < mortonCodes[b]; });
+
+    std::vector<uint8_t> emitted(triangleCount, 0);
+    // the meshlet every vertex was last added to, so a triangle knows which of its corners are new
+    std::vector<uint32_t> vertexMeshlet(positions.size(), kNone);
+    std::vector<uint32_t> ordered;
+    ordered.reserve(triangleCount * 3);
+    std::vector<FMeshlet> meshlets;
+    std::vector<uint32_t> meshletVertices;
+    std::vector<uint32_t> meshletTriangles;
+
+    size_t seed = 0;
+    while (true)
+    {
+        while (seed < triangleCount && emitted[seedOrder[seed]])
+        {
+            seed++;
+        }
+        if (seed == triangleCount)
+        {
+            break;
+        }
+
+        auto id = static_cast<uint32_t>(meshlets.size());
+        meshletVertices.clear();
+        meshletTriangles.clear();
+        glm::vec3 centroidSum(0.0f);
+        uint32_t next = seedOrder[seed];
+        while (next != kNone)
+        {
+            emitted[next] = 1;
+            meshletTriangles.push_back(next);
+            centroidSum += centroids[next];
+            for (int k = 0; k < 3; k++)
+            {
+                uint32_t vertex = inOutIndices[next * 3 + k];
+                if (vertexMeshlet[vertex] != id)
+                {
+                    vertexMeshlet[vertex] = id;
+                    meshletVertices.push_back(vertex);
+                }
+            }
+            if (meshletTriangles.size() == kMaxTriangles)
+            {
+                break;
+            }
+
+            // the neighbour adding the fewest vertices, the closest one on a tie
+            glm::vec3 centroid = centroidSum / float(meshletTriangles.size());
+            next = kNone;
+            int bestNewVertices = 4;
+            float bestDistance = std::numeric_limits<float>::max();
+            for (uint32_t vertex : meshletVertices)
+            {
+                uint32_t position = welded[vertex];
+                for (uint32_t i = vertexOffsets[position]; i < vertexOffsets[position + 1]; i++)
+                {
+                    uint32_t triangle = vertexTriangles[i];
+                    if (emitted[triangle])
+                    {
+                        continue;
+                    }
+                    int newVertices = 0;
+                    for (int k = 0; k < 3; k++)
+                    {
+                        newVertices += vertexMeshlet[inOutIndices[triangle * 3 + k]] != id;
+                    }
+                    if (meshletVertices.size() + newVertices > kMaxVertices)
+                    {
+                        continue;
+                    }
+                    glm::vec3 offset = centroids[triangle] - centroid;
+                    float distance = glm::dot(offset, offset);
+                    if (newVertices < bestNewVertices || (newVertices == bestNewVertices && distance < bestDistance))
+                    {
+                        next = triangle;
+                        bestNewVertices = newVertices;
+                        bestDistance = distance;
+                    }
+                }
+            }
+            if (next == kNone)
+            {
+                // no neighbour fits, take the next triangle in Morton order if it does
+                while (seed < triangleCount && emitted[seedOrder[seed]])
+                {
+                    seed++;
+                }
+                if (seed < triangleCount)
+                {
+                    uint32_t triangle = seedOrder[seed];
+                    size_t newVertices = 0;
+                    for (int k = 0; k < 3; k++)
+                    {
+                        newVertices += vertexMeshlet[inOutIndices[triangle * 3 + k]] != id;
+                    }
+                    if (meshletVertices.size() + newVertices <= kMaxVertices)
+                    {
+                        next = triangle;
+                    }
+                }
+            }
+        }
+
+        FMeshlet meshlet{};
+        meshlet.firstIndex = static_cast<uint32_t>(ordered.size());
+        meshlet.triangleCount = static_cast<uint32_t>(meshletTriangles.size());
+        for (uint32_t triangle : meshletTriangles)
+        {
+            ordered.insert(ordered.end(), inOutIndices.begin() + triangle * 3, inOutIndices.begin() + triangle * 3 + 3);
+        }
+        ComputeBounds(positions, ordered.data() + meshlet.firstIndex, meshlet);
+        meshlets.push_back(meshlet);
+    }
+
+    inOutIndices.swap(ordered);
+    return meshlets;
+}
+
+void FMeshletBuilder::ComputeBounds(const std::vector<glm::vec3>& positions, const uint32_t* indices, FMeshlet& meshlet)
+{
+    size_t indexCount = meshlet.triangleCount * 3;
+    glm::vec3 boundsMin(std::numeric_limits<float>::max());
+    glm::vec3 boundsMax(std::numeric_limits<float>::lowest());
+    for (size_t i = 0; i < indexCount; i++)
+    {
+        boundsMin = glm::min(boundsMin, positions[indices[i]]);
+        boundsMax = glm::max(boundsMax, positions[indices[i]]);
+    }
+    meshlet.center = (boundsMin + boundsMax) * 0.5f;
+    meshlet.radius = 0.0f;
+    for (size_t i = 0; i < indexCount; i++)
+    {
+        meshlet.radius = std::max(meshlet.radius, glm::length(positions[indices[i]] - meshlet.center));
+    }
+
+    // the axis is the average normal, the cone opens as far as the normal furthest from it
+    std::vector<glm::vec3> normals;
+    normals.reserve(meshlet.triangleCount);
+    glm::vec3 normalSum(0.0f);
+    for (size_t i = 0; i < indexCount; i += 3)
+    {
+        glm::vec3 p0 = positions[indices[i]], p1 = positions[indices[i + 1]], p2 = positions[indices[i + 2]];
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        float length = glm::length(normal);
+        if (length > 0.0f)
+        {
+            normals.push_back(normal / length);
+            normalSum += normals.back();
+        }
+    }
+    meshlet.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+    meshlet.coneCutoff = 1.0f;
+    float axisLength = glm::length(normalSum);
+    if (normals.empty() || axisLength <= 0.0f)
+    {
+        return;
+    }
+    glm::vec3 axis = normalSum / axisLength;
+    float minDot = 1.0f;
+    for (const auto& normal : normals)
+    {
+        minDot = std::min(minDot, glm::dot(axis, normal));
+    }
+    if (minDot <= kMinConeDot)
+    {
+        return;
+    }
+    // the normals are within acos(minDot) of the axis, so the triangles all face away from views
+    // more than 90 degrees plus that away from it: cos(90 + a) = -sin(a)
+    meshlet.coneAxis = axis;
+    meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+}
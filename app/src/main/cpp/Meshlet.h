@@ -0,0 +1,72 @@
+#ifndef ANDROIDGLINVESTIGATIONS_MESHLET_H
+#define ANDROIDGLINVESTIGATIONS_MESHLET_H
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+/*!
+ * A cluster of at most FMeshletBuilder::kMaxVertices vertices and kMaxTriangles triangles of a
+ * Mesh, a contiguous run of the model's index buffer. The layout of Shaders/meshlet.comp's
+ * Meshlet, 48 bytes.
+ */
+struct FMeshlet
+{
+    /*!
+     * Bounding sphere in model space
+     */
+    glm::vec3 center;
+    float radius;
+    /*!
+     * Normal cone: every triangle faces away from a viewer at p if
+     * dot(center - p, coneAxis) >= coneCutoff * length(center - p) + radius. A cutoff of 1 never
+     * culls.
+     */
+    glm::vec3 coneAxis;
+    float coneCutoff;
+    /*!
+     * First index in the index buffer, triangleCount triangles from there
+     */
+    uint32_t firstIndex;
+    uint32_t triangleCount;
+    /*!
+     * The Mesh the triangles belong to
+     */
+    uint32_t mesh;
+    uint32_t padding;
+};
+static_assert(sizeof(FMeshlet) == 48, "FMeshlet is the std430 layout of meshlet.comp");
+
+/*!
+ * Groups a triangle list into meshlets. A meshlet grows from a seed triangle by the neighbour that
+ * adds the fewest vertices, closest to its centroid on a tie, so it ends up a compact patch whose
+ * bounds and normal cone are tight enough to cull it on its own. Without a neighbour that fits it
+ * continues with the next triangle in Morton order.
+ */
+class FMeshletBuilder
+{
+public:
+    /*!
+     * The usual mesh shader sizes, small bounds without a sea of meshlets
+     */
+    static constexpr size_t kMaxVertices = 64;
+    static constexpr size_t kMaxTriangles = 124;
+
+    /*!
+     * Reorders the triangles of @a inOutIndices so every meshlet's are contiguous
+     * @param positions of the vertices @a inOutIndices refers to
+     * @return the meshlets in order, firstIndex relative to @a inOutIndices and mesh 0
+     */
+    static std::vector<FMeshlet> Build(const std::vector<glm::vec3>& positions, std::vector<uint32_t>& inOutIndices);
+
+private:
+    /*!
+     * Triangles whose normals spread further than this (cosine) from the cone axis give the
+     * meshlet a cone that never culls
+     */
+    static constexpr float kMinConeDot = 0.1f;
+
+    static void ComputeBounds(const std::vector<glm::vec3>& positions, const uint32_t* indices, FMeshlet& meshlet);
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_MESHLET_H
@@ -3,29 +3,62 @@
 //
 #include "Model.h"
 #include "AndroidOut.h"
+#include "CookedModel.h"
+#include "GLStateCache.h"
+#include "JobSystem.h"
+#include "MeshSimplifier.h"
+#include "SceneGraph.h"
+#include <algorithm>
+#include <cstring>
 #include <filesystem>
 #include <stddef.h>
+#include <limits>
+#include <glm/gtc/packing.hpp>
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 #include <assimp/pbrmaterial.h>
 
-std::shared_ptr<FModel> FModel::LoadAsset(AAssetManager *assetManager, const std::string & InModelPath) {
-    auto pModelAsset = AAssetManager_open(
-            assetManager,
-            InModelPath.c_str(),
-            AASSET_MODE_BUFFER);
-    const void* pBuffer = AAsset_getBuffer(pModelAsset);
-    size_t Length = AAsset_getLength(pModelAsset);
+std::shared_ptr<FModel> FModel::LoadAsset(AssetProvider &assets, const std::string & InModelPath) {
+    std::shared_ptr<FModel> Model = ImportAsset(assets, InModelPath);
+    if (Model) {
+        Model->GenerateVAO();
+    }
+    return Model;
+}
+
+std::shared_ptr<FModel> FModel::ImportAsset(AssetProvider &assets, const std::string & InModelPath) {
+    std::string CookedPath = std::filesystem::path(InModelPath).replace_extension(".mesh").string();
+    if (auto Mapping = assets.mapAsset(CookedPath)) {
+        std::shared_ptr<FModel> Model = std::make_shared<FModel>();
+        if (Model->LoadCooked(std::move(Mapping))) {
+            return Model;
+        }
+        aout << "[ERROR] " << CookedPath << " isn't a cooked model of this version, importing "
+             << InModelPath << std::endl;
+    }
+
+    std::vector<uint8_t> Buffer;
+    if (!assets.readAsset(InModelPath, Buffer)) {
+        return nullptr;
+    }
     std::shared_ptr<FModel> Model = std::make_shared<FModel>();
-    Model->Load(pBuffer, Length);
-    Model->GenerateVAO();
+    Model->Load(Buffer.data(), Buffer.size());
     return Model;
 }
 
 void FModel::Load(const void *InBuffer, size_t InLength) {
     Assimp::Importer importer;
-    const aiScene* scene = importer.ReadFileFromMemory(InBuffer, InLength, aiProcess_Triangulate | aiProcess_FlipUVs);
+    ProcessScene(importer, importer.ReadFileFromMemory(InBuffer, InLength, kImportFlags));
+}
+
+void FModel::LoadFile(const std::string &InPath) {
+    Assimp::Importer importer;
+    ProcessScene(importer, importer.ReadFile(InPath, kImportFlags));
+}
+
+void FModel::ProcessScene(const Assimp::Importer& importer, const aiScene* scene)
+{
     if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
     {
         aout << "[ERROR] Assimp " << importer.GetErrorString() << std::endl;
@@ -33,32 +66,98 @@ void FModel::Load(const void *InBuffer, size_t InLength) {
     }
 //    mModelDir = std::filesystem::path(InModelPath).parent_path();
 //    mFileName = std::filesystem::path(InModelPath).filename().string();
-    ProcessNode(scene->mRootNode, scene);
+    for (uint32_t i = 0; i < scene->mNumMaterials; i++)
+    {
+        aiString texture;
+        bool hasTexture = scene->mMaterials[i]->GetTexture(aiTextureType_DIFFUSE, 0, &texture) == AI_SUCCESS;
+        mMaterialTextures.emplace_back(hasTexture ? texture.C_Str() : "");
+    }
+
+    // the node transforms are baked into the vertices, a model is a single object in space
+    FSceneGraph nodes;
+    std::vector<std::pair<aiMesh*, uint32_t>> meshes;
+    ProcessNode(scene->mRootNode, scene, FSceneGraph::kNoParent, nodes, meshes);
+    nodes.Update();
+
+    // converting is independent per mesh, appending them has to keep the order
+    std::vector<std::vector<FVertex>> meshVertices(meshes.size());
+    std::vector<std::vector<uint32_t>> meshIndices(meshes.size());
+    jobSystem.parallelFor(0, meshes.size(), kConvertGrain, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            ConvertMesh(meshes[i].first, nodes.GetWorldMatrix(meshes[i].second), meshVertices[i], meshIndices[i]);
+        }
+    });
+    for (size_t i = 0; i < meshes.size(); i++)
+    {
+        ProcessMesh(meshVertices[i], meshIndices[i], static_cast<int>(meshes[i].first->mMaterialIndex));
+    }
+    BuildLods();
+    BuildMeshlets();
+    PackVertices();
 
     aout << "load assimp model" << std::endl;
 }
 
-void FModel::ProcessNode(aiNode* node, const aiScene* scene)
+void FModel::ProcessNode(aiNode* node, const aiScene* scene, int32_t parent, FSceneGraph& outNodes,
+                         std::vector<std::pair<aiMesh*, uint32_t>>& outMeshes)
 {
+    aiVector3D scale, translation;
+    aiQuaternion rotation;
+    node->mTransformation.Decompose(scale, rotation, translation);
+    uint32_t index = outNodes.AddNode(parent,
+                                      glm::vec3(translation.x, translation.y, translation.z),
+                                      glm::quat(rotation.w, rotation.x, rotation.y, rotation.z),
+                                      glm::vec3(scale.x, scale.y, scale.z));
     for (uint32_t i = 0; i < node->mNumMeshes; i++)
     {
-        auto* mesh = scene->mMeshes[node->mMeshes[i]];
-        ProcessMesh(mesh, scene);
+        outMeshes.emplace_back(scene->mMeshes[node->mMeshes[i]], index);
     }
 
     for (uint32_t i = 0; i < node->mNumChildren; i++)
     {
-        ProcessNode(node->mChildren[i], scene);
+        ProcessNode(node->mChildren[i], scene, static_cast<int32_t>(index), outNodes, outMeshes);
     }
 }
 
-void FModel::ProcessMesh(aiMesh* mesh, const aiScene* scene)
+void FModel::ConvertMesh(const aiMesh* mesh, const glm::mat4& transform, std::vector<FVertex>& meshVertices, std::vector<uint32_t>& meshIndices)
 {
-    Mesh smesh;
-    int vertexCount = 0;
+    ConvertMesh(mesh, meshVertices, meshIndices);
+    if (transform == glm::mat4(1.0f))
+    {
+        return;
+    }
+    glm::mat3 linear(transform);
+    glm::mat3 normalMatrix = glm::transpose(glm::inverse(linear));
+    for (auto& vertex : meshVertices)
+    {
+        vertex.pos = glm::vec3(transform * glm::vec4(vertex.pos, 1.0f));
+        if (mesh->mNormals)
+        {
+            vertex.normal = glm::normalize(normalMatrix * vertex.normal);
+        }
+        if (mesh->mTangents)
+        {
+            vertex.tangent = glm::normalize(linear * vertex.tangent);
+        }
+    }
+    // a mirroring transform turns the triangles inside out
+    if (glm::determinant(linear) < 0.0f)
+    {
+        for (size_t i = 0; i + 2 < meshIndices.size(); i += 3)
+        {
+            std::swap(meshIndices[i + 1], meshIndices[i + 2]);
+        }
+    }
+}
+
+void FModel::ConvertMesh(const aiMesh* mesh, std::vector<FVertex>& meshVertices, std::vector<uint32_t>& meshIndices)
+{
+    meshVertices.resize(mesh->mNumVertices);
     for (auto i = 0; i < mesh->mNumVertices; i++)
     {
-        FVertex vertex;
+        FVertex& vertex = meshVertices[i];
         if (mesh->mVertices)
         {
             aiVector3D& v = mesh->mVertices[i];
@@ -82,86 +181,808 @@ void FModel::ProcessMesh(aiMesh* mesh, const aiScene* scene)
             aiVector3D& b = mesh->mTangents[i];
             vertex.tangent = glm::vec3(b.x, b.y, b.z);
         }
-        vertices.push_back(vertex);
-        vertexCount++;
     }
-    smesh.vertexCount = vertexCount;
 
-    smesh.indexOffset = indices.size();
-    int indexCount = 0;
+    meshIndices.reserve(mesh->mNumFaces * 3);
     for (auto i = 0; i < mesh->mNumFaces; i++)
     {
-        aiFace& face = mesh->mFaces[i];
-        for (auto j = 0; j < face.mNumIndices; j++)
+        const aiFace& face = mesh->mFaces[i];
+        // aiProcess_Triangulate leaves points and lines as they are, they aren't drawn
+        if (face.mNumIndices != 3)
         {
-            indices.push_back(face.mIndices[j]);
-            indexCount++;
+            continue;
         }
+        meshIndices.insert(meshIndices.end(), face.mIndices, face.mIndices + 3);
     }
-    smesh.indexCount = indexCount;
+}
 
-    if (mesh->mMaterialIndex < 0)
+void FModel::ProcessMesh(const std::vector<FVertex>& meshVertices, const std::vector<uint32_t>& meshIndices, int material)
+{
+    if (meshVertices.size() <= kMaxMeshVertices)
     {
-        aout << "Mesh haven't got a material\n";
+        AddMesh(meshVertices, meshIndices, material);
         return;
     }
+
+    // Too many vertices for 16 bit indices: cut the triangle list into runs that reference at most
+    // kMaxMeshVertices vertices each, every run becomes a Mesh with its own copy of them
+    std::vector<int32_t> remap(meshVertices.size(), -1);
+    std::vector<uint32_t> chunkSources;
+    std::vector<FVertex> chunkVertices;
+    std::vector<uint32_t> chunkIndices;
+    int chunkCount = 0;
+    for (size_t i = 0; i < meshIndices.size(); i += 3)
+    {
+        int newVertices = 0;
+        for (size_t j = 0; j < 3; j++)
+        {
+            newVertices += remap[meshIndices[i + j]] == -1;
+        }
+        if (chunkVertices.size() + newVertices > kMaxMeshVertices)
+        {
+            AddMesh(chunkVertices, chunkIndices, material);
+            chunkCount++;
+            for (uint32_t source : chunkSources)
+            {
+                remap[source] = -1;
+            }
+            chunkSources.clear();
+            chunkVertices.clear();
+            chunkIndices.clear();
+        }
+        for (size_t j = 0; j < 3; j++)
+        {
+            uint32_t index = meshIndices[i + j];
+            if (remap[index] == -1)
+            {
+                remap[index] = static_cast<int32_t>(chunkVertices.size());
+                chunkSources.push_back(index);
+                chunkVertices.push_back(meshVertices[index]);
+            }
+            chunkIndices.push_back(remap[index]);
+        }
+    }
+    if (!chunkIndices.empty())
+    {
+        AddMesh(chunkVertices, chunkIndices, material);
+        chunkCount++;
+    }
+    aout << "Split mesh of " << meshVertices.size() << " vertices into " << chunkCount
+         << " meshes for 16 bit indices" << std::endl;
+}
+
+void FModel::AddMesh(const std::vector<FVertex>& meshVertices, const std::vector<uint32_t>& meshIndices, int material)
+{
+    Mesh smesh;
+    smesh.materialIndex = material;
+    smesh.vertexOffset = vertices.size();
+    smesh.vertexCount = meshVertices.size();
+    smesh.indexOffset = indices.size();
+    smesh.indexCount = meshIndices.size();
+    smesh.lods[0] = {smesh.indexOffset, smesh.indexCount, 0.0f};
+    smesh.boundsMin = glm::vec3(std::numeric_limits<float>::max());
+    smesh.boundsMax = glm::vec3(std::numeric_limits<float>::lowest());
+    for (const auto& vertex : meshVertices)
+    {
+        smesh.boundsMin = glm::min(smesh.boundsMin, vertex.pos);
+        smesh.boundsMax = glm::max(smesh.boundsMax, vertex.pos);
+    }
+    vertices.insert(vertices.end(), meshVertices.begin(), meshVertices.end());
+    // relative to the Mesh, the draw adds vertexOffset as its base vertex
+    for (uint32_t index : meshIndices)
+    {
+        indices.push_back(static_cast<Index>(index));
+    }
+
+    mVisibleMeshes.push_back(mMeshes.size());
     mMeshes.push_back(smesh);
+    mBounds.Add(smesh.boundsMin, smesh.boundsMax);
+}
+
+/*!
+ * Maps a unit vector onto the [-1, 1] square of an octahedron unfolded around +z
+ */
+static glm::vec2 OctahedralEncode(const glm::vec3& n)
+{
+    float l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    if (l1 == 0.0f)
+    {
+        return glm::vec2(0.0f);
+    }
+    glm::vec2 p = glm::vec2(n) / l1;
+    if (n.z < 0.0f)
+    {
+        glm::vec2 sign(p.x >= 0.0f ? 1.0f : -1.0f, p.y >= 0.0f ? 1.0f : -1.0f);
+        p = (1.0f - glm::abs(glm::vec2(p.y, p.x))) * sign;
+    }
+    return p;
+}
+
+static FPackedVertex PackVertex(const FVertex& vertex, const glm::vec3& offset, const glm::vec3& invScale)
+{
+    FPackedVertex packed{};
+    glm::vec3 pos = (vertex.pos - offset) * invScale;
+    glm::vec2 normal = OctahedralEncode(vertex.normal);
+    glm::vec2 tangent = OctahedralEncode(vertex.tangent);
+    for (int i = 0; i < 3; i++)
+    {
+        packed.pos[i] = glm::packUnorm1x16(pos[i]);
+    }
+    for (int i = 0; i < 2; i++)
+    {
+        packed.normal[i] = static_cast<int16_t>(glm::packSnorm1x16(normal[i]));
+        packed.tangent[i] = static_cast<int16_t>(glm::packSnorm1x16(tangent[i]));
+        packed.uv0[i] = glm::packHalf1x16(vertex.uv0[i]);
+    }
+    return packed;
+}
+
+void FModel::BuildLods()
+{
+    // simplified per Mesh in parallel, appended in order afterwards
+    struct FLodIndices
+    {
+        std::vector<uint32_t> indices;
+        float error;
+    };
+    std::vector<std::vector<FLodIndices>> meshLods(mMeshes.size());
+    jobSystem.parallelFor(0, mMeshes.size(), kLodGrain, [&](size_t begin, size_t end)
+    {
+        for (size_t m = begin; m < end; m++)
+        {
+            const Mesh& mesh = mMeshes[m];
+            std::vector<glm::vec3> positions(mesh.vertexCount), normals(mesh.vertexCount);
+            std::vector<glm::vec2> uvs(mesh.vertexCount);
+            for (int i = 0; i < mesh.vertexCount; i++)
+            {
+                const FVertex& vertex = vertices[mesh.vertexOffset + i];
+                positions[i] = vertex.pos;
+                normals[i] = vertex.normal;
+                uvs[i] = vertex.uv0;
+            }
+            std::vector<uint32_t> meshIndices(indices.begin() + mesh.indexOffset,
+                                              indices.begin() + mesh.indexOffset + mesh.indexCount);
+            float radius = glm::length(mesh.boundsMax - mesh.boundsMin) * 0.5f;
+
+            // each level continues from the last, with half the triangles and a larger error
+            FMeshSimplifier simplifier(positions, normals, uvs, meshIndices);
+            size_t fullTriangles = meshIndices.size() / 3;
+            size_t previousTriangles = fullTriangles;
+            for (int lod = 1; lod < kMaxMeshLods; lod++)
+            {
+                auto lodIndices = simplifier.Simplify(fullTriangles >> lod, kLodMaxErrors[lod - 1] * radius);
+                size_t triangles = lodIndices.size() / 3;
+                if (triangles == 0 || triangles > previousTriangles * (1.0f - kMinLodReduction))
+                {
+                    continue;
+                }
+                previousTriangles = triangles;
+                meshLods[m].push_back({std::move(lodIndices), simplifier.GetError()});
+            }
+        }
+    });
+
+    size_t lodTriangles = 0;
+    size_t fullTriangles = 0;
+    for (size_t m = 0; m < mMeshes.size(); m++)
+    {
+        Mesh& mesh = mMeshes[m];
+        fullTriangles += mesh.indexCount / 3;
+        for (const auto& lod : meshLods[m])
+        {
+            mesh.lods[mesh.lodCount++] = {int(indices.size()), int(lod.indices.size()), lod.error};
+            for (uint32_t index : lod.indices)
+            {
+                indices.push_back(static_cast<Index>(index));
+            }
+            lodTriangles += lod.indices.size() / 3;
+        }
+    }
+    aout << "Built LODs: " << lodTriangles << " triangles over " << fullTriangles << " at full detail" << std::endl;
+}
+
+void FModel::BuildMeshlets()
+{
+    // per Mesh in parallel, its LODs are ranges of the index buffer no other Mesh touches
+    std::vector<std::vector<FMeshlet>> meshMeshlets(mMeshes.size());
+    jobSystem.parallelFor(0, mMeshes.size(), kMeshletGrain, [&](size_t begin, size_t end)
+    {
+        for (size_t m = begin; m < end; m++)
+        {
+            const Mesh& mesh = mMeshes[m];
+            std::vector<glm::vec3> positions(mesh.vertexCount), normals(mesh.vertexCount);
+            std::vector<glm::vec2> uvs(mesh.vertexCount);
+            for (int i = 0; i < mesh.vertexCount; i++)
+            {
+                const FVertex& vertex = vertices[mesh.vertexOffset + i];
+                positions[i] = vertex.pos;
+                normals[i] = vertex.normal;
+                uvs[i] = vertex.uv0;
+            }
+            for (int lod = 0; lod < mesh.lodCount; lod++)
+            {
+                auto first = indices.begin() + mesh.lods[lod].indexOffset;
+                std::vector<uint32_t> lodIndices(first, first + mesh.lods[lod].indexCount);
+                for (FMeshlet meshlet : FMeshletBuilder::Build(positions, lodIndices))
+                {
+                    meshlet.firstIndex += mesh.lods[lod].indexOffset;
+                    meshlet.mesh = static_cast<uint32_t>(m);
+                    meshMeshlets[m].push_back(meshlet);
+                }
+                std::transform(lodIndices.begin(), lodIndices.end(), first, [](uint32_t index)
+                {
+                    return static_cast<Index>(index);
+                });
+            }
+        }
+    });
+
+    size_t triangles = 0;
+    for (const auto& meshlets : meshMeshlets)
+    {
+        for (const auto& meshlet : meshlets)
+        {
+            triangles += meshlet.triangleCount;
+        }
+        mMeshlets.insert(mMeshlets.end(), meshlets.begin(), meshlets.end());
+    }
+    mMeshletCount = mMeshlets.size();
+    aout << "Built " << mMeshletCount << " meshlets of " << (mMeshletCount ? triangles / mMeshletCount : 0)
+         << " triangles on average" << std::endl;
+}
+
+void FModel::PackVertices()
+{
+    // quantize positions to the bounds of the whole vertex buffer, one scale and offset per draw
+    glm::vec3 boundsMin(std::numeric_limits<float>::max());
+    glm::vec3 boundsMax(std::numeric_limits<float>::lowest());
+    for (const auto& vertex : vertices)
+    {
+        boundsMin = glm::min(boundsMin, vertex.pos);
+        boundsMax = glm::max(boundsMax, vertex.pos);
+    }
+    if (vertices.empty())
+    {
+        boundsMin = boundsMax = glm::vec3(0.0f);
+    }
+    mPositionOffset = boundsMin;
+    mPositionScale = boundsMax - boundsMin;
+    glm::vec3 invScale = glm::vec3(
+            mPositionScale.x > 0.0f ? 1.0f / mPositionScale.x : 0.0f,
+            mPositionScale.y > 0.0f ? 1.0f / mPositionScale.y : 0.0f,
+            mPositionScale.z > 0.0f ? 1.0f / mPositionScale.z : 0.0f);
+    mPackedVertices.resize(vertices.size());
+    jobSystem.parallelFor(0, vertices.size(), kPackGrain, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            mPackedVertices[i] = PackVertex(vertices[i], mPositionOffset, invScale);
+        }
+    });
+}
+
+static uint32_t AlignCooked(size_t offset)
+{
+    return static_cast<uint32_t>((offset + kCookedModelAlignment - 1) & ~size_t(kCookedModelAlignment - 1));
+}
+
+static_assert(kMaxMeshLods == kCookedMaxLods, "a cooked mesh stores every LOD of a Mesh");
+
+void FModel::Cook(std::vector<uint8_t>& outBlob) const
+{
+    FCookedModelHeader header{};
+    header.magic = kCookedModelMagic;
+    header.version = kCookedModelVersion;
+    header.vertexStride = sizeof(FPackedVertex);
+    header.indexSize = sizeof(Index);
+    header.vertexCount = static_cast<uint32_t>(mPackedVertices.size());
+    header.indexCount = static_cast<uint32_t>(indices.size());
+    header.meshCount = static_cast<uint32_t>(mMeshes.size());
+    header.materialCount = static_cast<uint32_t>(mMaterialTextures.size());
+    for (int i = 0; i < 3; i++)
+    {
+        header.positionScale[i] = mPositionScale[i];
+        header.positionOffset[i] = mPositionOffset[i];
+    }
+    header.verticesOffset = AlignCooked(sizeof(header));
+    header.indicesOffset = AlignCooked(header.verticesOffset + sizeof(FPackedVertex) * mPackedVertices.size());
+    header.meshesOffset = AlignCooked(header.indicesOffset + sizeof(Index) * indices.size());
+    header.materialsOffset = AlignCooked(header.meshesOffset + sizeof(FCookedMesh) * mMeshes.size());
+    header.meshletCount = static_cast<uint32_t>(mMeshlets.size());
+    header.meshletsOffset = AlignCooked(header.materialsOffset + sizeof(FCookedMaterial) * mMaterialTextures.size());
+    header.fileSize = AlignCooked(header.meshletsOffset + sizeof(FMeshlet) * mMeshlets.size());
+
+    // zero filled, so padding and unused name bytes are deterministic
+    outBlob.assign(header.fileSize, 0);
+    std::memcpy(outBlob.data(), &header, sizeof(header));
+    std::memcpy(outBlob.data() + header.verticesOffset, mPackedVertices.data(), sizeof(FPackedVertex) * mPackedVertices.size());
+    std::memcpy(outBlob.data() + header.indicesOffset, indices.data(), sizeof(Index) * indices.size());
+    std::memcpy(outBlob.data() + header.meshletsOffset, mMeshlets.data(), sizeof(FMeshlet) * mMeshlets.size());
+
+    auto* meshes = reinterpret_cast<FCookedMesh*>(outBlob.data() + header.meshesOffset);
+    for (size_t i = 0; i < mMeshes.size(); i++)
+    {
+        const Mesh& mesh = mMeshes[i];
+        FCookedMesh& cooked = meshes[i];
+        cooked = FCookedMesh{};
+        cooked.vertexOffset = mesh.vertexOffset;
+        cooked.vertexCount = uint32_t(mesh.vertexCount);
+        cooked.indexOffset = uint32_t(mesh.indexOffset);
+        cooked.indexCount = uint32_t(mesh.indexCount);
+        std::memcpy(cooked.boundsMin, &mesh.boundsMin, sizeof(cooked.boundsMin));
+        std::memcpy(cooked.boundsMax, &mesh.boundsMax, sizeof(cooked.boundsMax));
+        cooked.material = mesh.materialIndex;
+        cooked.lodCount = uint32_t(mesh.lodCount);
+        for (int lod = 1; lod < mesh.lodCount; lod++)
+        {
+            cooked.lodIndexOffset[lod - 1] = uint32_t(mesh.lods[lod].indexOffset);
+            cooked.lodIndexCount[lod - 1] = uint32_t(mesh.lods[lod].indexCount);
+            cooked.lodError[lod - 1] = mesh.lods[lod].error;
+        }
+    }
+
+    auto* materials = reinterpret_cast<FCookedMaterial*>(outBlob.data() + header.materialsOffset);
+    for (size_t i = 0; i < mMaterialTextures.size(); i++)
+    {
+        const std::string& texture = mMaterialTextures[i];
+        if (texture.size() >= sizeof(materials[i].baseColorTexture))
+        {
+            aout << "[ERROR] Texture path " << texture << " is too long, material " << i << " has none" << std::endl;
+            continue;
+        }
+        std::memcpy(materials[i].baseColorTexture, texture.c_str(), texture.size());
+    }
+}
+
+bool FModel::LoadCooked(std::unique_ptr<AssetMapping> mapping)
+{
+    const uint8_t* data = mapping->getData();
+    size_t size = mapping->getSize();
+    if (size < sizeof(FCookedModelHeader))
+    {
+        return false;
+    }
+    FCookedModelHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    auto fits = [size](uint32_t offset, size_t count, size_t stride)
+    {
+        return offset % kCookedModelAlignment == 0 && offset <= size && count <= (size - offset) / stride;
+    };
+    if (header.magic != kCookedModelMagic || header.version != kCookedModelVersion
+        || header.vertexStride != sizeof(FPackedVertex) || header.indexSize != sizeof(Index)
+        || header.fileSize != size
+        || !fits(header.verticesOffset, header.vertexCount, sizeof(FPackedVertex))
+        || !fits(header.indicesOffset, header.indexCount, sizeof(Index))
+        || !fits(header.meshesOffset, header.meshCount, sizeof(FCookedMesh))
+        || !fits(header.materialsOffset, header.materialCount, sizeof(FCookedMaterial))
+        || !fits(header.meshletsOffset, header.meshletCount, sizeof(FMeshlet)))
+    {
+        return false;
+    }
+
+    mPositionScale = glm::vec3(header.positionScale[0], header.positionScale[1], header.positionScale[2]);
+    mPositionOffset = glm::vec3(header.positionOffset[0], header.positionOffset[1], header.positionOffset[2]);
+
+    // the tables are small, only the streams stay in the mapping
+    const auto* meshes = reinterpret_cast<const FCookedMesh*>(data + header.meshesOffset);
+    for (uint32_t i = 0; i < header.meshCount; i++)
+    {
+        const FCookedMesh& cooked = meshes[i];
+        bool lodsFit = cooked.lodCount >= 1 && cooked.lodCount <= kCookedMaxLods;
+        for (uint32_t lod = 1; lodsFit && lod < cooked.lodCount; lod++)
+        {
+            lodsFit = uint64_t(cooked.lodIndexOffset[lod - 1]) + cooked.lodIndexCount[lod - 1] <= header.indexCount;
+        }
+        if (uint64_t(cooked.indexOffset) + cooked.indexCount > header.indexCount
+            || cooked.vertexOffset < 0 || uint64_t(cooked.vertexOffset) + cooked.vertexCount > header.vertexCount
+            || !lodsFit)
+        {
+            mMeshes.clear();
+            return false;
+        }
+        Mesh mesh;
+        mesh.materialIndex = cooked.material;
+        mesh.vertexOffset = cooked.vertexOffset;
+        mesh.vertexCount = static_cast<int>(cooked.vertexCount);
+        mesh.indexOffset = static_cast<int>(cooked.indexOffset);
+        mesh.indexCount = static_cast<int>(cooked.indexCount);
+        mesh.boundsMin = glm::vec3(cooked.boundsMin[0], cooked.boundsMin[1], cooked.boundsMin[2]);
+        mesh.boundsMax = glm::vec3(cooked.boundsMax[0], cooked.boundsMax[1], cooked.boundsMax[2]);
+        mesh.lodCount = static_cast<int>(cooked.lodCount);
+        mesh.lods[0] = {mesh.indexOffset, mesh.indexCount, 0.0f};
+        for (uint32_t lod = 1; lod < cooked.lodCount; lod++)
+        {
+            mesh.lods[lod] = {int(cooked.lodIndexOffset[lod - 1]), int(cooked.lodIndexCount[lod - 1]), cooked.lodError[lod - 1]};
+        }
+        mVisibleMeshes.push_back(i);
+        mMeshes.push_back(mesh);
+        mBounds.Add(mesh.boundsMin, mesh.boundsMax);
+    }
+
+    // the culling shader reads the meshlets' index ranges, they have to be within the buffer
+    const auto* meshlets = reinterpret_cast<const FMeshlet*>(data + header.meshletsOffset);
+    for (uint32_t i = 0; i < header.meshletCount; i++)
+    {
+        if (meshlets[i].mesh >= header.meshCount
+            || uint64_t(meshlets[i].firstIndex) + uint64_t(meshlets[i].triangleCount) * 3 > header.indexCount)
+        {
+            mMeshes.clear();
+            return false;
+        }
+    }
+    mMeshletCount = header.meshletCount;
+
+    const auto* materials = reinterpret_cast<const FCookedMaterial*>(data + header.materialsOffset);
+    for (uint32_t i = 0; i < header.materialCount; i++)
+    {
+        const char* texture = materials[i].baseColorTexture;
+        mMaterialTextures.emplace_back(texture, strnlen(texture, sizeof(materials[i].baseColorTexture)));
+    }
+
+    mCooked = std::move(mapping);
+    return true;
 }
 
 void FModel::GenerateVAO()
 {
+    // either straight from the cooked blob or from what Load imported
+    const void* vertexData = mPackedVertices.data();
+    size_t vertexBytes = sizeof(FPackedVertex) * mPackedVertices.size();
+    const void* indexData = indices.data();
+    size_t indexBytes = sizeof(Index) * indices.size();
+    const void* meshletData = mMeshlets.data();
+    if (mCooked)
+    {
+        FCookedModelHeader header;
+        std::memcpy(&header, mCooked->getData(), sizeof(header));
+        vertexData = mCooked->getData() + header.verticesOffset;
+        vertexBytes = sizeof(FPackedVertex) * header.vertexCount;
+        indexData = mCooked->getData() + header.indicesOffset;
+        indexBytes = sizeof(Index) * header.indexCount;
+        meshletData = mCooked->getData() + header.meshletsOffset;
+    }
+
     glGenVertexArrays(1, &vao);
-    glBindVertexArray(vao);
+    glState.bindVertexArray(vao);
     GLuint vbo;
     glGenBuffers(1, &vbo);
-    GLuint ebo;
-    glGenBuffers(1, &ebo);
+    glGenBuffers(1, &mIndexBuffer);
     glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(FVertex) * vertices.size(), vertices.data(), GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(FVertex), (void*)0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(FVertex), (void*)offsetof(FVertex, normal));
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(FVertex), (void*)offsetof(FVertex, uv0));
-    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(FVertex), (void*)offsetof(FVertex, tangent));
-    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(FVertex), (void*)offsetof(FVertex, color));
+    glBufferData(GL_ARRAY_BUFFER, vertexBytes, vertexData, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(FPackedVertex), (void*)offsetof(FPackedVertex, pos));
+    glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(FPackedVertex), (void*)offsetof(FPackedVertex, normal));
+    glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(FPackedVertex), (void*)offsetof(FPackedVertex, uv0));
+    glVertexAttribPointer(3, 2, GL_SHORT, GL_TRUE, sizeof(FPackedVertex), (void*)offsetof(FPackedVertex, tangent));
     glEnableVertexAttribArray(0);
     glEnableVertexAttribArray(1);
     glEnableVertexAttribArray(2);
     glEnableVertexAttribArray(3);
-    glEnableVertexAttribArray(4);
+    // the instance matrix advances per instance, BindForDraw points it at the frame's instances
+    for (GLuint column = 0; column < 4; column++)
+    {
+        glEnableVertexAttribArray(kInstanceAttribute + column);
+        glVertexAttribDivisor(kInstanceAttribute + column, 1);
+    }
+
+    // the meshlet culling reads the indices as 32 bit words
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mIndexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, (indexBytes + 3) & ~size_t(3), nullptr, GL_STATIC_DRAW);
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, indexBytes, indexData);
+
+    // the same quantized positions and indices on their own
+    size_t vertexCount = vertexBytes / sizeof(FPackedVertex);
+    std::vector<uint16_t> positions(vertexCount * 4, 0);
+    const auto* packedVertices = static_cast<const FPackedVertex*>(vertexData);
+    for (size_t i = 0; i < vertexCount; i++)
+    {
+        std::memcpy(&positions[i * 4], packedVertices[i].pos, sizeof(packedVertices[i].pos));
+    }
+    glGenVertexArrays(1, &mDepthVao);
+    glState.bindVertexArray(mDepthVao);
+    GLuint positionBuffer;
+    glGenBuffers(1, &positionBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, positionBuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(uint16_t) * positions.size(), positions.data(), GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(uint16_t) * 4, (void*)0);
+    glEnableVertexAttribArray(0);
+    for (GLuint column = 0; column < 4; column++)
+    {
+        glEnableVertexAttribArray(kInstanceAttribute + column);
+        glVertexAttribDivisor(kInstanceAttribute + column, 1);
+    }
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mIndexBuffer);
+    glState.bindVertexArray(0);
+
+    // the compacted triangles of a set fit every Mesh at full detail, the largest LOD
+    GLuint meshletIndexCapacity = 0;
+    if (mMeshletCount > 0)
+    {
+        for (const auto& mesh : mMeshes)
+        {
+            meshletIndexCapacity += GLuint(mesh.indexCount);
+        }
+        glGenBuffers(1, &mMeshletBuffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, mMeshletBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(FMeshlet) * mMeshletCount, meshletData, GL_STATIC_DRAW);
+        glGenBuffers(1, &mMeshletIndexBuffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, mMeshletIndexBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint) * meshletIndexCapacity * kIndirectCommandSets, nullptr, GL_DYNAMIC_COPY);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+
+    // the GPU has its copy now
+    std::vector<FPackedVertex>().swap(mPackedVertices);
+    std::vector<FMeshlet>().swap(mMeshlets);
+    mCooked.reset();
+
+    std::vector<DrawElementsIndirectCommand> commands;
+    for (int set = 0; set < kIndirectCommandSets; set++)
+    {
+        for (const auto& mesh : mMeshes)
+        {
+            // the first set draws everything until a culling pass says otherwise
+            GLuint instanceCount = set == 0 ? 1 : 0;
+            commands.push_back({GLuint(mesh.indexCount), instanceCount, GLuint(mesh.indexOffset), mesh.vertexOffset, 0});
+        }
+    }
+    // empty until the meshlet culling appends to them, the indices are absolute
+    for (int set = 0; set < kIndirectCommandSets; set++)
+    {
+        commands.push_back({0, 0, meshletIndexCapacity * set, 0, 0});
+    }
+
+    glGenBuffers(1, &indirectBuffer);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(DrawElementsIndirectCommand) * commands.size(), commands.data(), GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+
+/*!
+ * The axis aligned box around a box transformed by @a transform
+ */
+static void TransformBox(const glm::mat4& transform, const glm::vec3& center, const glm::vec3& extent,
+                         glm::vec3& outCenter, glm::vec3& outExtent)
+{
+    glm::mat3 linear(transform);
+    outCenter = linear * center + glm::vec3(transform[3]);
+    outExtent = glm::abs(linear[0]) * extent.x + glm::abs(linear[1]) * extent.y + glm::abs(linear[2]) * extent.z;
+}
+
+void FModel::FrustumCull(const FFrustum& frustum, const glm::vec3& viewOrigin, float projectionScale)
+{
+    // whole instances first, the positions are quantized to the bounds of the model
+    if (mInstancesChanged)
+    {
+        glm::vec3 modelExtent = mPositionScale * 0.5f;
+        glm::vec3 modelCenter = mPositionOffset + modelExtent;
+        mInstanceBoxesMin.resize(mInstances.size());
+        mInstanceBoxesMax.resize(mInstances.size());
+        for (size_t i = 0; i < mInstances.size(); i++)
+        {
+            glm::vec3 center, extent;
+            TransformBox(mInstances[i], modelCenter, modelExtent, center, extent);
+            mInstanceBoxesMin[i] = center - extent;
+            mInstanceBoxesMax[i] = center + extent;
+        }
+        mInstanceBvh.Update(mInstanceBoxesMin, mInstanceBoxesMax);
+        mInstancesChanged = false;
+    }
+    else
+    {
+        mInstanceBvh.Poll();
+    }
+    mVisibleInstanceIndices.clear();
+    mInstanceBvh.CullFrustum(frustum, mVisibleInstanceIndices);
+    mVisibleInstances.clear();
+    for (uint32_t instance : mVisibleInstanceIndices)
+    {
+        mVisibleInstances.push_back(mInstances[instance]);
+    }
+
+    mVisibleMeshes.clear();
+    mWorldBounds.Clear();
+    if (mVisibleInstances.empty())
+    {
+        return;
+    }
+
+    // one instanced draw covers a Mesh in every visible instance, so it's tested with the union
+    // and drawn at the LOD of the closest one
+    mMeshCulls.resize(mMeshes.size());
+    mMeshLods.resize(mMeshes.size(), 0);
+    jobSystem.parallelFor(0, mMeshes.size(), kWorldBoundsGrain, [&](size_t begin, size_t end)
+    {
+        for (size_t mesh = begin; mesh < end; mesh++)
+        {
+            glm::vec3 center(mBounds.centerX[mesh], mBounds.centerY[mesh], mBounds.centerZ[mesh]);
+            glm::vec3 extent(mBounds.extentX[mesh], mBounds.extentY[mesh], mBounds.extentZ[mesh]);
+            float radius = glm::length(extent);
+            glm::vec3 boundsMin(std::numeric_limits<float>::max());
+            glm::vec3 boundsMax(std::numeric_limits<float>::lowest());
+            float screenSize = 0.0f;
+            for (const auto& instance : mVisibleInstances)
+            {
+                glm::vec3 worldCenter, worldExtent;
+                TransformBox(instance, center, extent, worldCenter, worldExtent);
+                boundsMin = glm::min(boundsMin, worldCenter - worldExtent);
+                boundsMax = glm::max(boundsMax, worldCenter + worldExtent);
+
+                float scale = std::max(std::max(glm::length(glm::vec3(instance[0])), glm::length(glm::vec3(instance[1]))),
+                                       glm::length(glm::vec3(instance[2])));
+                float worldRadius = radius * scale;
+                float distance = glm::length(worldCenter - viewOrigin);
+                screenSize = distance > worldRadius
+                             ? std::max(screenSize, worldRadius * projectionScale / distance)
+                             : std::numeric_limits<float>::max();
+            }
+
+            const Mesh& meshData = mMeshes[mesh];
+            int lod = std::min<int>(mMeshLods[mesh], meshData.lodCount - 1);
+            while (lod + 1 < meshData.lodCount && screenSize < kLodScreenSizes[lod] * (1.0f - kLodHysteresis))
+            {
+                lod++;
+            }
+            while (lod > 0 && screenSize > kLodScreenSizes[lod - 1] * (1.0f + kLodHysteresis))
+            {
+                lod--;
+            }
+            mMeshLods[mesh] = static_cast<uint8_t>(lod);
+            mMeshCulls[mesh] = {boundsMin, uint32_t(meshData.lods[lod].indexOffset),
+                                boundsMax, uint32_t(meshData.lods[lod].indexCount)};
+        }
+    });
+    for (const auto& cull : mMeshCulls)
+    {
+        mWorldBounds.Add(cull.boundsMin, cull.boundsMax);
+    }
+    frustum.CullBoxes(mWorldBounds, mVisibleMeshes);
+}
+
+size_t FModel::GetVisibleTriangleCount(bool fullDetail) const
+{
+    size_t triangles = 0;
+    for (uint32_t mesh : mVisibleMeshes)
+    {
+        int lod = fullDetail || mesh >= mMeshLods.size() ? 0 : mMeshLods[mesh];
+        triangles += mMeshes[mesh].lods[lod].indexCount / 3;
+    }
+    return triangles * mVisibleInstances.size();
+}
+
+bool FModel::Raycast(const glm::vec3& origin, const glm::vec3& direction, float& inOutDistance,
+                     uint32_t& outInstance, uint32_t& outMesh) const
+{
+    uint32_t hitMesh = 0;
+    bool hit = mInstanceBvh.Raycast(origin, direction, inOutDistance, outInstance, [&](uint32_t instance, float& distance)
+    {
+        if (instance >= mInstances.size())
+        {
+            return false;
+        }
+        // an affine transform keeps the ray parameter, so distances compare across instances
+        glm::mat4 inverse = glm::inverse(mInstances[instance]);
+        glm::vec3 localOrigin = glm::vec3(inverse * glm::vec4(origin, 1.0f));
+        glm::vec3 inverseDirection = 1.0f / (glm::mat3(inverse) * direction);
+        bool found = false;
+        for (size_t mesh = 0; mesh < mBounds.Size(); mesh++)
+        {
+            glm::vec3 center(mBounds.centerX[mesh], mBounds.centerY[mesh], mBounds.centerZ[mesh]);
+            glm::vec3 extent(mBounds.extentX[mesh], mBounds.extentY[mesh], mBounds.extentZ[mesh]);
+            float enter = FBvh::IntersectBox(localOrigin, inverseDirection, center - extent, center + extent, distance);
+            if (enter < distance)
+            {
+                distance = enter;
+                hitMesh = static_cast<uint32_t>(mesh);
+                found = true;
+            }
+        }
+        return found;
+    });
+    if (hit)
+    {
+        outMesh = hitMesh;
+    }
+    return hit;
+}
+
+bool FModel::UploadFrameData(StreamBuffer& stream)
+{
+    mFrameBuffer = stream.getBuffer();
+    if (mVisibleInstances.empty())
+    {
+        return true;
+    }
+    // vertex attributes and the meshlet culling's storage buffer both read the instances
+    auto instances = stream.write(mVisibleInstances.data(), sizeof(glm::mat4) * mVisibleInstances.size(),
+                                  std::max<size_t>(sizeof(glm::vec4), stream.getStorageAlignment()));
+    auto culls = stream.write(mMeshCulls.data(), sizeof(FMeshCull) * mMeshCulls.size(), stream.getStorageAlignment());
+    if (!instances || !culls)
+    {
+        mVisibleInstances.clear();
+        mVisibleMeshes.clear();
+        return false;
+    }
+    mInstanceOffset = instances.offset;
+    mMeshCullOffset = culls.offset;
+    return true;
+}
+
+void FModel::Draw(int commandSet)
+{
+    BindForDraw();
+    // ES 3.1 has no multi draw indirect: meshes outside the frustum cost no call at all, occluded
+    // ones are skipped on the GPU by instanceCount 0
+    for (uint32_t i : mVisibleMeshes)
+    {
+        DrawMesh(commandSet, i);
+    }
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void FModel::BindForDraw(bool depthOnly) const
+{
+    glState.bindVertexArray(depthOnly ? mDepthVao : vao);
+    glBindBuffer(GL_ARRAY_BUFFER, mFrameBuffer);
+    for (GLuint column = 0; column < 4; column++)
+    {
+        glVertexAttribPointer(kInstanceAttribute + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4),
+                              (void*)(mInstanceOffset + sizeof(glm::vec4) * column));
+    }
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+}
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint) * indices.size(), indices.data(), GL_STATIC_DRAW);
-    glBindVertexArray(0);
+void FModel::DrawMesh(int commandSet, uint32_t mesh) const
+{
+    size_t command = commandSet * mMeshes.size() + mesh;
+    glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_SHORT, (void*)(command * sizeof(DrawElementsIndirectCommand)));
 }
 
+void FModel::DrawMeshlets(int commandSet) const
+{
+    // the compacted triangles stand in for the index buffer during the draw
+    size_t command = kIndirectCommandSets * mMeshes.size() + commandSet;
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mMeshletIndexBuffer);
+    glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(command * sizeof(DrawElementsIndirectCommand)));
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mIndexBuffer);
+}
 
-void FModel::Draw()
+size_t FModel::ReadMeshletTriangleCount() const
 {
-    glBindVertexArray(vao);
-    for (int i = 0; i < mMeshes.size(); i++)
+    if (mMeshletCount == 0)
     {
-        auto& mesh = mMeshes[i];
-        glDrawElements(GL_TRIANGLES, mesh.indexCount, GL_UNSIGNED_INT, (void*)(mesh.indexOffset * sizeof(unsigned int)));
+        return 0;
+    }
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+    auto* commands = static_cast<const DrawElementsIndirectCommand*>(glMapBufferRange(
+            GL_DRAW_INDIRECT_BUFFER, sizeof(DrawElementsIndirectCommand) * kIndirectCommandSets * mMeshes.size(),
+            sizeof(DrawElementsIndirectCommand) * kIndirectCommandSets, GL_MAP_READ_BIT));
+    size_t triangles = 0;
+    if (commands)
+    {
+        for (int set = 0; set < kIndirectCommandSets; set++)
+        {
+            triangles += size_t(commands[set].count / 3) * commands[set].instanceCount;
+        }
+        glUnmapBuffer(GL_DRAW_INDIRECT_BUFFER);
     }
-    glBindVertexArray(0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    return triangles;
 }
 
 void FMeshPrimitive::draw(const unsigned int readTex1, const unsigned int readTex2, const unsigned int readTex3)
 {
-    glBindVertexArray(VAO);
+    glState.bindVertexArray(VAO);
     if (readTex1 != 0) {
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, readTex1);
+        glState.bindTexture(0, GL_TEXTURE_2D, readTex1);
     }
 
     if (readTex2 != 0) {
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, readTex2);
+        glState.bindTexture(1, GL_TEXTURE_2D, readTex2);
     }
 
     if (readTex3 != 0) {
-        glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, readTex3);
+        glState.bindTexture(2, GL_TEXTURE_2D, readTex3);
     }
 
     glDrawArrays(GL_TRIANGLES, 0, numVertices);
@@ -169,7 +990,7 @@ void FMeshPrimitive::draw(const unsigned int readTex1, const unsigned int readTe
 
 void FQuad::draw(const unsigned int readTex1, const unsigned int readTex2, const unsigned int readTex3)
 {
-    glDisable(GL_DEPTH_TEST);
+    glState.setEnabled(GL_DEPTH_TEST, false);
     FMeshPrimitive::draw(readTex1, readTex2, readTex3);
 }
 
@@ -191,7 +1012,7 @@ void FQuad::setup()
     glGenBuffers(1, &VBO);
 
     //Bind Vertex Array Object and VBO in correct order
-    glBindVertexArray(VAO);
+    glState.bindVertexArray(VAO);
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
 
     //VBO initialization
@@ -205,5 +1026,5 @@ void FQuad::setup()
     glEnableVertexAttribArray(1);
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
 
-    glBindVertexArray(0);
+    glState.bindVertexArray(0);
 }
\ No newline at end of file
@@ -5,9 +5,17 @@
 #include <filesystem>
 #include <glm/glm.hpp>
 #include <assimp/Importer.hpp>
+#include <assimp/postprocess.h>
 #include <assimp/scene.h>
+#include "Bvh.h"
+#include "Frustum.h"
+#include "Meshlet.h"
+#include "Platform.h"
+#include "StreamBuffer.h"
 #include "TextureAsset.h"
 
+class FSceneGraph;
+
 union Vector3 {
     struct {
         float x, y, z;
@@ -74,33 +82,403 @@ struct FVertex
     glm::vec3 normal;
     glm::vec2 uv0;
     glm::vec3 tangent;
-    glm::vec3 color;
+};
+
+/*!
+ * The GPU layout of FVertex, 20 instead of 44 bytes. The position is unorm16 within the bounds of
+ * the model, see FModel::GetPositionScale. Normal and tangent are octahedral encoded snorm16, the
+ * uv is half float.
+ */
+struct FPackedVertex
+{
+    uint16_t pos[3];
+    uint16_t padding;
+    int16_t normal[2];
+    int16_t tangent[2];
+    uint16_t uv0[2];
+};
+static_assert(sizeof(FPackedVertex) == 20, "FPackedVertex must stay tightly packed");
+
+/*!
+ * Levels of detail of a Mesh, the full one included
+ */
+static constexpr int kMaxMeshLods = 4;
+
+/*!
+ * One level of detail of a Mesh, a range of the index buffer over the Mesh's vertices
+ */
+struct FMeshLod
+{
+    int indexOffset;
+    int indexCount;
+    /*!
+     * How far the simplified surface may be from the full one, in model units
+     */
+    float error;
 };
 
 struct Mesh
 {
     int materialIndex = -1;
+    int vertexOffset;
     int vertexCount;
     int indexOffset;
     int indexCount;
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+    /*!
+     * lods[0] is the full mesh, indexOffset and indexCount, the others get coarser
+     */
+    int lodCount = 1;
+    FMeshLod lods[kMaxMeshLods];
+};
+
+/*!
+ * Layout of one glDrawElementsIndirect command
+ */
+struct DrawElementsIndirectCommand
+{
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint reservedMustBeZero;
 };
 
 class FModel {
 public:
-    static std::shared_ptr<FModel> LoadAsset(AAssetManager *assetManager, const std::string &assetPath);
+    /*!
+     * Largest vertex count of a Mesh, so its indices fit 16 bits. One less than 65536 keeps the
+     * primitive restart index 0xFFFF unused. Bigger meshes get split on load.
+     */
+    static constexpr size_t kMaxMeshVertices = 65535;
+
+    static std::shared_ptr<FModel> LoadAsset(AssetProvider &assets, const std::string &assetPath);
+
+    /*!
+     * The part of LoadAsset that doesn't need GL, so it can run on any thread. GenerateVAO on the
+     * render thread makes the model drawable.
+     *
+     * A cooked sibling of the asset, the same path with a .mesh extension, is mapped instead of
+     * importing the asset, see CookedModel.h.
+     * @return the model, nullptr if the asset can't be read
+     */
+    static std::shared_ptr<FModel> ImportAsset(AssetProvider &assets, const std::string &assetPath);
 
     void Load(const void *InBuffer, size_t InLength);
+
+    /*!
+     * Like Load, but from a file, so the importer finds the files it references such as an OBJ's
+     * material library
+     */
+    void LoadFile(const std::string &InPath);
+
+    /*!
+     * Takes over a cooked model. The streams stay in @a mapping until GenerateVAO uploads them.
+     * @return false if it isn't a cooked model of this version and vertex layout
+     */
+    bool LoadCooked(std::unique_ptr<AssetMapping> mapping);
+
+    /*!
+     * Writes what Load imported as a cooked model, call it before GenerateVAO
+     */
+    void Cook(std::vector<uint8_t>& outBlob) const;
+    /*!
+     * Number of DrawElementsIndirectCommand sets in the indirect buffer, one per culling phase
+     */
+    static constexpr int kIndirectCommandSets = 2;
+
+    /*!
+     * First of the four vertex attributes taking the columns of an instance's world matrix
+     */
+    static constexpr GLuint kInstanceAttribute = 4;
+
     void GenerateVAO();
-    void Draw();
+
+    /*!
+     * Places the model once per world matrix. Every Mesh is drawn for all visible instances with
+     * a single instanced draw. A model starts out with one identity instance.
+     */
+    void SetInstances(std::vector<glm::mat4> instances)
+    {
+        mInstances = std::move(instances);
+        mInstancesChanged = true;
+    }
+
+    const std::vector<glm::mat4>& GetInstances() const { return mInstances; }
+
+    /*!
+     * Culls the instances with a BVH over their bounds, then tests every Mesh with the union of its
+     * bounds over the visible instances. The BVH is refit when the instances move. Draw() submits
+     * only the meshes that pass, for the instances that pass, until the next call.
+     *
+     * Also picks the LOD of every Mesh from the projected size of its bounding sphere at the
+     * closest visible instance, see kLodScreenSizes.
+     * @param viewOrigin the camera position
+     * @param projectionScale projection[1][1], turns radius / distance into a fraction of half
+     * the viewport height
+     */
+    void FrustumCull(const FFrustum& frustum, const glm::vec3& viewOrigin, float projectionScale);
+
+    /*!
+     * @return the triangles of the meshes that passed the last FrustumCull over all visible
+     * instances, at their LOD or at full detail
+     */
+    size_t GetVisibleTriangleCount(bool fullDetail = false) const;
+
+    /*!
+     * Finds the closest Mesh bounds a ray hits, in any instance
+     * @param direction normalized, in world space like @a origin
+     * @param inOutDistance the furthest distance to look at, the distance of the hit on return
+     * @return true if a Mesh was hit, @a outInstance and @a outMesh say which
+     */
+    bool Raycast(const glm::vec3& origin, const glm::vec3& direction, float& inOutDistance,
+                 uint32_t& outInstance, uint32_t& outMesh) const;
+
+    /*!
+     * @return the BVH over the world bounds of the instances
+     */
+    const FBvh& GetInstanceBvh() const { return mInstanceBvh; }
+
+    /*!
+     * Writes the world matrices of the visible instances, the world bounds and LODs of the meshes
+     * to @a stream, for BindForDraw and the GPU culling. Call it after FrustumCull with @a stream
+     * mapped.
+     * @return false if @a stream is full, nothing is drawn this frame then
+     */
+    bool UploadFrameData(StreamBuffer& stream);
+
+    /*!
+     * @return the instances that passed the last FrustumCull, each visible Mesh is drawn this many
+     * times
+     */
+    size_t GetVisibleInstanceCount() const { return mVisibleInstances.size(); }
+
+    /*!
+     * Draws the meshes that passed FrustumCull with the commands of one set of the indirect buffer
+     */
+    void Draw(int commandSet = 0);
+
+    /*!
+     * Binds the vertex array and the indirect buffer for DrawMesh
+     * @param depthOnly binds a vertex array with only the positions, for depth only passes. Their
+     * vertex shader has to compute the position exactly like the color pass'.
+     */
+    void BindForDraw(bool depthOnly = false) const;
+
+    /*!
+     * Draws one Mesh with its command of a set of the indirect buffer, see BindForDraw
+     */
+    void DrawMesh(int commandSet, uint32_t mesh) const;
+
+    /*!
+     * Draws the triangles the meshlet culling of one phase kept, all meshes in one draw, see
+     * BindForDraw and OcclusionCulling
+     */
+    void DrawMeshlets(int commandSet) const;
+
+    /*!
+     * Reads back how many triangles the meshlet culling kept in the last frame, over all visible
+     * instances. Waits for the GPU, meant for statistics after a run.
+     */
+    size_t ReadMeshletTriangleCount() const;
+
+    size_t GetVisibleMeshCount() const { return mVisibleMeshes.size(); }
+
+    /*!
+     * @return the meshes that passed the last FrustumCull
+     */
+    const std::vector<uint32_t>& GetVisibleMeshes() const { return mVisibleMeshes; }
+
+    /*!
+     * @return the object space bounds of every Mesh
+     */
+    const FBoundsSoA& GetBounds() const { return mBounds; }
+
+    /*!
+     * @return the world space bounds of every Mesh over the instances visible at the last
+     * FrustumCull
+     */
+    const FBoundsSoA& GetWorldBounds() const { return mWorldBounds; }
+
+    GLuint GetVertexArray() const { return vao; }
+
+    /*!
+     * @return the base color texture of every material relative to the model's directory, empty
+     * for materials without one. Mesh::materialIndex indexes it.
+     */
+    const std::vector<std::string>& GetMaterialTextures() const { return mMaterialTextures; }
+
+    size_t GetMeshCount() const { return mMeshes.size(); }
+
+    /*!
+     * Dequantizes the positions of the vertex buffer: object space = unorm * scale + offset
+     */
+    const glm::vec3 &GetPositionScale() const { return mPositionScale; }
+
+    const glm::vec3 &GetPositionOffset() const { return mPositionOffset; }
+
+    /*!
+     * The world bounds and this frame's LOD of a Mesh, the layout of the culling shader's MeshCull
+     */
+    struct FMeshCull
+    {
+        glm::vec3 boundsMin;
+        uint32_t firstIndex;
+        glm::vec3 boundsMax;
+        uint32_t indexCount;
+    };
+
+    /*!
+     * @return the buffer and offset of what UploadFrameData wrote for the GPU culling, an FMeshCull
+     * (world bounds and the index range of the LOD) per Mesh
+     */
+    GLuint GetFrameBuffer() const { return mFrameBuffer; }
+
+    GLintptr GetMeshCullOffset() const { return mMeshCullOffset; }
+
+    GLintptr GetInstanceOffset() const { return mInstanceOffset; }
+
+    /*!
+     * @return the buffer with kIndirectCommandSets sets of one DrawElementsIndirectCommand per
+     * Mesh, followed by one meshlet draw per set. Culling passes zero the instanceCount of hidden
+     * meshes and fill in the meshlet draws.
+     */
+    GLuint GetIndirectBuffer() const { return indirectBuffer; }
+
+    /*!
+     * @return the 16 bit indices of every Mesh and LOD, padded to a multiple of 4 bytes
+     */
+    GLuint GetIndexBuffer() const { return mIndexBuffer; }
+
+    /*!
+     * Every LOD of every Mesh is split into meshlets, see FMeshletBuilder
+     */
+    size_t GetMeshletCount() const { return mMeshletCount; }
+
+    /*!
+     * @return the buffer of the FMeshlet of every Mesh and LOD, in Mesh order
+     */
+    GLuint GetMeshletBuffer() const { return mMeshletBuffer; }
+
+    /*!
+     * @return the 32 bit indices the meshlet culling compacts the kept triangles into, one region
+     * per command set, each large enough for every Mesh at full detail
+     */
+    GLuint GetMeshletIndexBuffer() const { return mMeshletIndexBuffer; }
 private:
-    void ProcessNode(aiNode* node, const aiScene* scene);
-    void ProcessMesh(aiMesh* mesh, const aiScene* scene);
+    /*!
+     * Meshes converted and vertices packed per job, see JobSystem::parallelFor
+     */
+    static constexpr size_t kConvertGrain = 64;
+    static constexpr size_t kPackGrain = 16384;
+    /*!
+     * Meshes whose world bounds one job computes, see FrustumCull
+     */
+    static constexpr size_t kWorldBoundsGrain = 256;
+    /*!
+     * Meshes one job simplifies into LODs, or splits into meshlets
+     */
+    static constexpr size_t kLodGrain = 4;
+    static constexpr size_t kMeshletGrain = 4;
+
+    /*!
+     * Projected sphere size, as a fraction of half the viewport height, below which LOD i + 1
+     * replaces LOD i. A switch needs kLodHysteresis more or less than that, so a Mesh at the
+     * threshold doesn't flicker between two.
+     */
+    static constexpr float kLodScreenSizes[kMaxMeshLods - 1] = {0.25f, 0.1f, 0.04f};
+    static constexpr float kLodHysteresis = 0.15f;
+    /*!
+     * The largest error of LOD i + 1 relative to the bounding sphere radius. Around a pixel at the
+     * size it starts at on a 720p screen.
+     */
+    static constexpr float kLodMaxErrors[kMaxMeshLods - 1] = {0.01f, 0.025f, 0.07f};
+    /*!
+     * A LOD has to cut at least this fraction of the triangles of the previous one to be kept
+     */
+    static constexpr float kMinLodReduction = 0.1f;
+
+    static constexpr unsigned kImportFlags = aiProcess_Triangulate | aiProcess_FlipUVs;
+
+    void ProcessScene(const Assimp::Importer& importer, const aiScene* scene);
+
+    /*!
+     * Adds @a node and its children to @a outNodes, depth first, and collects their meshes with
+     * the node that places them
+     */
+    void ProcessNode(aiNode* node, const aiScene* scene, int32_t parent, FSceneGraph& outNodes,
+                     std::vector<std::pair<aiMesh*, uint32_t>>& outMeshes);
+    /*!
+     * Copies the vertices and triangles of @a mesh, safe to run for several meshes at once
+     */
+    static void ConvertMesh(const aiMesh* mesh, std::vector<FVertex>& meshVertices, std::vector<uint32_t>& meshIndices);
+    /*!
+     * Same, with the vertices moved to model space by the world matrix of the mesh's node
+     */
+    static void ConvertMesh(const aiMesh* mesh, const glm::mat4& transform, std::vector<FVertex>& meshVertices, std::vector<uint32_t>& meshIndices);
+    /*!
+     * Adds a converted mesh, split into several if it has more than kMaxMeshVertices vertices
+     */
+    void ProcessMesh(const std::vector<FVertex>& meshVertices, const std::vector<uint32_t>& meshIndices, int material);
+    /*!
+     * Appends a Mesh with indices relative to its first vertex, at most kMaxMeshVertices of them
+     */
+    void AddMesh(const std::vector<FVertex>& meshVertices, const std::vector<uint32_t>& meshIndices, int material);
+    /*!
+     * Simplifies every Mesh into up to kMaxMeshLods - 1 coarser index lists over its vertices, and
+     * appends them to the index buffer
+     */
+    void BuildLods();
+    /*!
+     * Splits every LOD of every Mesh into meshlets, reordering its triangles so each meshlet is a
+     * contiguous range
+     */
+    void BuildMeshlets();
+    /*!
+     * Quantizes vertices into mPackedVertices, which GenerateVAO uploads and releases
+     */
+    void PackVertices();
     GLuint vao;
+    // the positions alone, 8 instead of 20 bytes a vertex to fetch in depth only passes
+    GLuint mDepthVao = 0;
+    GLuint indirectBuffer = 0;
+    GLuint mIndexBuffer = 0;
+    GLuint mMeshletBuffer = 0;
+    GLuint mMeshletIndexBuffer = 0;
     std::filesystem::path mModelDir;
     std::string mFileName;
     std::vector<Mesh> mMeshes;
-    std::vector<uint> indices;
+    // object space bounds of mMeshes, in the same order
+    FBoundsSoA mBounds;
+    std::vector<uint32_t> mVisibleMeshes;
+    std::vector<Index> indices;
     std::vector<FVertex> vertices;
+    std::vector<FPackedVertex> mPackedVertices;
+    // what BuildMeshlets made, until GenerateVAO uploads it
+    std::vector<FMeshlet> mMeshlets;
+    size_t mMeshletCount = 0;
+    // the cooked model the streams come from instead of the vectors above, until GenerateVAO
+    std::unique_ptr<AssetMapping> mCooked;
+    std::vector<std::string> mMaterialTextures;
+    std::vector<glm::mat4> mInstances = {glm::mat4(1.0f)};
+    bool mInstancesChanged = true;
+    // the world bounds of the instances and the hierarchy over them
+    std::vector<glm::vec3> mInstanceBoxesMin;
+    std::vector<glm::vec3> mInstanceBoxesMax;
+    FBvh mInstanceBvh;
+    // this frame's visible instances and the world bounds of the meshes
+    std::vector<uint32_t> mVisibleInstanceIndices;
+    std::vector<glm::mat4> mVisibleInstances;
+    FBoundsSoA mWorldBounds;
+    std::vector<FMeshCull> mMeshCulls;
+    // the LOD every Mesh is drawn at
+    std::vector<uint8_t> mMeshLods;
+    GLuint mFrameBuffer = 0;
+    GLintptr mInstanceOffset = 0;
+    GLintptr mMeshCullOffset = 0;
+    glm::vec3 mPositionScale = glm::vec3(0.0f);
+    glm::vec3 mPositionOffset = glm::vec3(0.0f);
 };
 
 struct FMeshPrimitive {
@@ -0,0 +1,130 @@
+#include "OcclusionCulling.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "GLStateCache.h"
+
+OcclusionCulling::Visibility::Visibility(size_t meshCount, size_t meshletCount) {
+    std::vector<GLuint> bits((meshCount + 31) / 32, ~0u);
+    glGenBuffers(1, &buffer_);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint) * std::max<size_t>(bits.size(), 1),
+                 bits.data(), GL_DYNAMIC_COPY);
+    if (meshletCount > 0) {
+        // visible, then not drawn early
+        size_t words = (meshletCount + 31) / 32;
+        std::vector<GLuint> meshletBits(words * 2, 0u);
+        std::fill(meshletBits.begin(), meshletBits.begin() + words, ~0u);
+        glGenBuffers(1, &meshletBuffer_);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, meshletBuffer_);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint) * meshletBits.size(),
+                     meshletBits.data(), GL_DYNAMIC_COPY);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+OcclusionCulling::Visibility::~Visibility() {
+    if (buffer_) {
+        glDeleteBuffers(1, &buffer_);
+        buffer_ = 0;
+    }
+    if (meshletBuffer_) {
+        glDeleteBuffers(1, &meshletBuffer_);
+        meshletBuffer_ = 0;
+    }
+}
+
+void OcclusionCulling::Uniforms::resolve(const Shader &shader) {
+    phase = shader.getUniform<int>("phase");
+    meshCount = shader.getUniform<int>("meshCount");
+    instanceCount = shader.getUniform<int>("instanceCount");
+    viewProjection = shader.getUniform<glm::mat4>("viewProjection");
+    useHZB = shader.getUniform<bool>("useHZB");
+    hzbViewProjection = shader.getUniform<glm::mat4>("hzbViewProjection");
+    reverseZ = shader.getUniform<bool>("reverseZ");
+    viewportSize = shader.getUniform<glm::ivec2>("viewportSize");
+    hzbSize = shader.getUniform<glm::ivec2>("hzbSize");
+    hzbMipCount = shader.getUniform<int>("hzbMipCount");
+}
+
+void OcclusionCulling::setup(std::unique_ptr<Shader> cullShader, std::unique_ptr<Shader> meshletShader) {
+    cullShader_ = std::move(cullShader);
+    cullUniforms_.resolve(*cullShader_);
+    meshletShader_ = std::move(meshletShader);
+    if (meshletShader_) {
+        meshletUniforms_.resolve(*meshletShader_);
+        meshletCountUniform_ = meshletShader_->getUniform<int>("meshletCount");
+        cameraPositionUniform_ = meshletShader_->getUniform<glm::vec3>("cameraPosition");
+    }
+}
+
+void OcclusionCulling::begin(const Shader &shader, const Uniforms &uniforms, const FModel &model, Phase phase,
+                             const glm::mat4 &viewProjection, const HZB *hzb, const glm::mat4 &hzbViewProjection) {
+    shader.activate();
+    shader.Set(uniforms.phase, phase == Phase::Early ? 0 : 1);
+    shader.Set(uniforms.meshCount, static_cast<int>(model.GetMeshCount()));
+    shader.Set(uniforms.instanceCount, static_cast<int>(model.GetVisibleInstanceCount()));
+    shader.Set(uniforms.viewProjection, viewProjection);
+    shader.Set(uniforms.useHZB, hzb != nullptr);
+    if (hzb) {
+        shader.Set(uniforms.hzbViewProjection, hzbViewProjection);
+        shader.Set(uniforms.reverseZ, hzb->isReverseZ());
+        shader.Set(uniforms.viewportSize, hzb->getViewportSize());
+        shader.Set(uniforms.hzbSize, hzb->getMipSize(0));
+        shader.Set(uniforms.hzbMipCount, hzb->getMipCount());
+        glState.bindTexture(0, GL_TEXTURE_2D, hzb->getTexture());
+    }
+}
+
+void OcclusionCulling::cull(const FModel &model,
+                            const Visibility &visibility,
+                            Phase phase,
+                            const glm::mat4 &viewProjection,
+                            const glm::vec3 &cameraPosition,
+                            const HZB *hzb,
+                            const glm::mat4 &hzbViewProjection,
+                            bool meshlets) {
+    int meshCount = static_cast<int>(model.GetMeshCount());
+    int instanceCount = static_cast<int>(model.GetVisibleInstanceCount());
+    if (meshCount == 0 || instanceCount == 0) {
+        // no world bounds were uploaded and nothing of the model is drawn
+        return;
+    }
+
+    begin(*cullShader_, cullUniforms_, model, phase, viewProjection, hzb, hzbViewProjection);
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 0, model.GetFrameBuffer(),
+                      model.GetMeshCullOffset(), sizeof(FModel::FMeshCull) * meshCount);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, model.GetIndirectBuffer());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, visibility.getBuffer());
+    glDispatchCompute((meshCount + kGroupSize - 1) / kGroupSize, 1, 1);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, 0);
+    cullShader_->deactivate();
+
+    int meshletCount = static_cast<int>(model.GetMeshletCount());
+    if (!meshlets || !meshletShader_ || meshletCount == 0) {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, 0);
+        return;
+    }
+
+    // the meshlets go by the commands the dispatch above wrote, within this pass the render
+    // graph can't see that
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    begin(*meshletShader_, meshletUniforms_, model, phase, viewProjection, hzb, hzbViewProjection);
+    meshletShader_->Set(meshletCountUniform_, meshletCount);
+    meshletShader_->Set(cameraPositionUniform_, cameraPosition);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, model.GetMeshletBuffer());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, visibility.getMeshletBuffer());
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 3, model.GetFrameBuffer(),
+                      model.GetInstanceOffset(), sizeof(glm::mat4) * instanceCount);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, model.GetIndexBuffer());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, model.GetMeshletIndexBuffer());
+    glDispatchCompute((meshletCount + kGroupSize - 1) / kGroupSize, 1, 1);
+
+    for (GLuint binding = 0; binding < kMeshletStorageBlocks; binding++) {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, 0);
+    }
+    meshletShader_->deactivate();
+}
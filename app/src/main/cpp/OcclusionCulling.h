@@ -0,0 +1,135 @@
+#ifndef ANDROIDGLINVESTIGATIONS_OCCLUSIONCULLING_H
+#define ANDROIDGLINVESTIGATIONS_OCCLUSIONCULLING_H
+
+#include <glm/glm.hpp>
+#include <memory>
+
+#include "HZB.h"
+#include "Model.h"
+#include "Shader.h"
+
+/*!
+ * Two-phase GPU culling of the submeshes of an FModel. Shaders/occlusion.comp tests each Mesh's
+ * world bounds over the visible instances against the frustum and an HZB, and writes the result straight into the model's indirect
+ * draw buffer so FModel::Draw() never waits on a readback.
+ *
+ * The early phase selects what was visible last frame, which is drawn and used to build the HZB.
+ * The late phase tests everything against that HZB and selects what the early phase missed, so
+ * newly revealed meshes show up in the same frame instead of popping in a frame later.
+ *
+ * With meshlet culling, Shaders/meshlet.comp follows each phase and culls the meshlets of the
+ * selected meshes by frustum, normal cone and HZB, then compacts the triangles left into one
+ * index buffer: FModel::DrawMeshlets() draws a whole model per phase. It needs
+ * kMeshletStorageBlocks storage buffers in a compute shader, more than the 4 ES 3.1 guarantees.
+ */
+class OcclusionCulling {
+public:
+    static constexpr int kGroupSize = 64;
+    static constexpr int kMeshletStorageBlocks = 6;
+
+    enum class Phase {
+        /*!
+         * Writes command set 0 from last frame's visibility
+         */
+        Early,
+        /*!
+         * Writes command set 1 and the visibility for the next frame
+         */
+        Late
+    };
+
+    /*!
+     * The visibility of every Mesh and meshlet of one model at the end of the last frame, one bit
+     * each, kept on the GPU. Everything starts visible.
+     */
+    class Visibility {
+    public:
+        Visibility(size_t meshCount, size_t meshletCount);
+
+        ~Visibility();
+
+        Visibility(const Visibility &) = delete;
+
+        Visibility &operator=(const Visibility &) = delete;
+
+        GLuint getBuffer() const { return buffer_; }
+
+        /*!
+         * @return the meshlet bits, followed by as many bits the early phase sets for the meshlets
+         * it drew
+         */
+        GLuint getMeshletBuffer() const { return meshletBuffer_; }
+
+    private:
+        GLuint buffer_ = 0;
+        GLuint meshletBuffer_ = 0;
+    };
+
+    /*!
+     * @param meshletShader the meshlet.comp program, nullptr if it didn't build, there's no
+     * meshlet culling then
+     */
+    void setup(std::unique_ptr<Shader> cullShader, std::unique_ptr<Shader> meshletShader);
+
+    /*!
+     * @return true once setup handed over the programs
+     */
+    bool isReady() const { return cullShader_ != nullptr; }
+
+    bool hasMeshletCulling() const { return meshletShader_ != nullptr; }
+
+    /*!
+     * Records the culling dispatch of one model. The indirect draws and the next phase need a
+     * command and shader storage barrier, the render graph derives them.
+     * @param model the model whose indirect buffer gets updated, its frame data uploaded
+     * @param visibility the visibility bits of @a model
+     * @param phase which command set to write
+     * @param viewProjection the matrix the model is about to be drawn with
+     * @param cameraPosition the camera of @a viewProjection, for the meshlet cones
+     * @param hzb the pyramid to test against, nullptr for frustum culling only
+     * @param hzbViewProjection the matrix @a hzb was rendered with
+     * @param meshlets true to cull and compact the meshlets as well, for DrawMeshlets
+     */
+    void cull(const FModel &model,
+              const Visibility &visibility,
+              Phase phase,
+              const glm::mat4 &viewProjection,
+              const glm::vec3 &cameraPosition,
+              const HZB *hzb,
+              const glm::mat4 &hzbViewProjection,
+              bool meshlets);
+
+private:
+    /*!
+     * The uniforms both culling shaders have
+     */
+    struct Uniforms {
+        void resolve(const Shader &shader);
+
+        UniformHandle<int> phase;
+        UniformHandle<int> meshCount;
+        UniformHandle<int> instanceCount;
+        UniformHandle<glm::mat4> viewProjection;
+        UniformHandle<bool> useHZB;
+        UniformHandle<glm::mat4> hzbViewProjection;
+        UniformHandle<bool> reverseZ;
+        UniformHandle<glm::ivec2> viewportSize;
+        UniformHandle<glm::ivec2> hzbSize;
+        UniformHandle<int> hzbMipCount;
+    };
+
+    /*!
+     * Activates @a shader and sets what both shaders share
+     */
+    static void begin(const Shader &shader, const Uniforms &uniforms, const FModel &model, Phase phase,
+                      const glm::mat4 &viewProjection, const HZB *hzb, const glm::mat4 &hzbViewProjection);
+
+    std::unique_ptr<Shader> cullShader_;
+    Uniforms cullUniforms_;
+    std::unique_ptr<Shader> meshletShader_;
+    Uniforms meshletUniforms_;
+    UniformHandle<int> meshletCountUniform_;
+    UniformHandle<glm::vec3> cameraPositionUniform_;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_OCCLUSIONCULLING_H
@@ -0,0 +1,147 @@
+#ifndef ANDROIDGLINVESTIGATIONS_PLATFORM_H
+#define ANDROIDGLINVESTIGATIONS_PLATFORM_H
+
+#include <EGL/egl.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/*!
+ * A whole asset in memory, read-only and valid as long as the object lives. Depending on the
+ * platform the bytes are mapped straight from the file or read into a buffer.
+ */
+class AssetMapping {
+public:
+    virtual ~AssetMapping() = default;
+
+    const uint8_t *getData() const { return data_; }
+
+    size_t getSize() const { return size_; }
+
+protected:
+    const uint8_t *data_ = nullptr;
+    size_t size_ = 0;
+};
+
+/*!
+ * Read-only access to the files shipped in the assets/ directory. On Android this is backed by the
+ * AAssetManager, on desktop by the plain filesystem.
+ */
+class AssetProvider {
+public:
+    virtual ~AssetProvider() = default;
+
+    /*!
+     * Reads a whole asset into memory
+     * @param assetPath the path of the asset relative to the assets/ directory
+     * @param outData receives the contents of the asset
+     * @return false if the asset doesn't exist or couldn't be read
+     */
+    virtual bool readAsset(const std::string &assetPath, std::vector<uint8_t> &outData) = 0;
+
+    /*!
+     * Convenience wrapper around @a readAsset for text assets such as shaders
+     * @return the contents of the asset, or an empty string if it couldn't be read
+     */
+    std::string readText(const std::string &assetPath) {
+        std::vector<uint8_t> data;
+        if (!readAsset(assetPath, data)) {
+            return {};
+        }
+        return {data.begin(), data.end()};
+    }
+
+    /*!
+     * Maps a whole asset without copying it where the platform allows. Unlike @a readAsset this
+     * logs nothing for a missing asset, so it can probe for optional ones.
+     * @return the mapping, nullptr if the asset doesn't exist or couldn't be mapped
+     */
+    virtual std::unique_ptr<AssetMapping> mapAsset(const std::string &assetPath) = 0;
+};
+
+/*!
+ * A single pointer (touch, mouse) event, already translated from the platform representation
+ */
+struct PointerEvent {
+    enum class Action {
+        Down,
+        Up,
+        Move,
+        Cancel
+    };
+
+    Action action;
+    int32_t pointerId;
+    float x;
+    float y;
+};
+
+/*!
+ * A single key event, already translated from the platform representation
+ */
+struct KeyEvent {
+    enum class Action {
+        Down,
+        Up,
+        Multiple
+    };
+
+    Action action;
+    int32_t keyCode;
+};
+
+/*!
+ * All the input that arrived since the last call to @a Platform::pollInput
+ */
+struct InputEvents {
+    std::vector<PointerEvent> pointerEvents;
+    std::vector<KeyEvent> keyEvents;
+};
+
+/*!
+ * Everything the Renderer needs from the OS: the EGL display and the surface to draw into, asset
+ * file access and an input source. Implement this to run the same render path somewhere else than
+ * an android_app.
+ */
+class Platform {
+public:
+    virtual ~Platform() = default;
+
+    /*!
+     * @return the EGL display to initialize. The Renderer takes care of eglInitialize/eglTerminate
+     */
+    virtual EGLDisplay getDisplay() = 0;
+
+    /*!
+     * @return the EGL_SURFACE_TYPE bits a config must support to be used with @a createSurface
+     */
+    virtual EGLint getSurfaceType() const = 0;
+
+    /*!
+     * Creates the surface the Renderer presents to. Ownership is passed to the caller.
+     * @param display the display returned by @a getDisplay
+     * @param config the config the Renderer chose
+     * @return the new surface or EGL_NO_SURFACE on failure
+     */
+    virtual EGLSurface createSurface(EGLDisplay display, EGLConfig config) = 0;
+
+    /*!
+     * @return the asset provider used for shaders, models and textures
+     */
+    virtual AssetProvider &getAssets() = 0;
+
+    /*!
+     * @return a writable directory for data that may be rebuilt at any time, like compiled
+     * shaders, or an empty string if there is none
+     */
+    virtual std::string getCacheDir() const = 0;
+
+    /*!
+     * Collects the pending input events and clears the platform queue
+     * @param outEvents receives the events, previous contents are kept
+     */
+    virtual void pollInput(InputEvents &outEvents) = 0;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_PLATFORM_H
@@ -0,0 +1,181 @@
+#include "Profiler.h"
+
+#include <EGL/egl.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+#include "AndroidOut.h"
+#include "Utility.h"
+
+Profiler::~Profiler() {
+    if (!allQueries_.empty()) {
+        glDeleteQueries(allQueries_.size(), allQueries_.data());
+    }
+}
+
+void Profiler::init() {
+    if (Utility::hasGlExtension("GL_EXT_disjoint_timer_query")) {
+        glGetQueryObjectui64vEXT_ = reinterpret_cast<PFNGLGETQUERYOBJECTUI64VEXTPROC>(
+                eglGetProcAddress("glGetQueryObjectui64vEXT"));
+    }
+    gpuTimerSupported_ = glGetQueryObjectui64vEXT_ != nullptr;
+    aout << "GPU timer queries " << (gpuTimerSupported_ ? "enabled" : "unavailable") << std::endl;
+
+    // clear any disjoint event that happened before we started timing
+    GLint disjoint = 0;
+    if (gpuTimerSupported_) {
+        glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+    }
+}
+
+void Profiler::beginFrame() {
+    auto &pending = pendingQueries_[frameIndex_ % kQueryLatency];
+    if (!pending.empty()) {
+        // A disjoint event (frequency change, context loss...) makes every in-flight result
+        // meaningless, drop them instead of polluting the history.
+        // The first frame is dropped as well: it pays for lazy driver allocations, and some
+        // drivers report a bogus start time for the very first query of a context.
+        GLint disjoint = frameIndex_ == kQueryLatency;
+        if (!disjoint) {
+            glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+        }
+
+        // the top level zones don't overlap, their sum is the frame's GPU time
+        float frameTime = 0.f;
+        bool frameComplete = !disjoint;
+        for (const auto &pendingQuery: pending) {
+            GLuint available = 0;
+            glGetQueryObjectuiv(pendingQuery.query, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available && !disjoint) {
+                GLuint64 elapsed = 0;
+                glGetQueryObjectui64vEXT_(pendingQuery.query, GL_QUERY_RESULT, &elapsed);
+                zones_[pendingQuery.zone].gpu.add(elapsed / 1e6f);
+                frameTime += elapsed / 1e6f;
+            } else {
+                frameComplete = false;
+            }
+            // an unavailable result is simply discarded once the query is reused
+            freeQueries_.push_back(pendingQuery.query);
+        }
+        if (frameComplete) {
+            zones_[findZone(kFrameZone)].gpu.add(frameTime);
+        }
+        pending.clear();
+    }
+    frameStart_ = Clock::now();
+}
+
+void Profiler::endFrame() {
+    assert(openZones_.empty());
+    std::chrono::duration<float, std::milli> frameTime = Clock::now() - frameStart_;
+    zones_[findZone(kFrameZone)].cpu.add(frameTime.count());
+    frameIndex_++;
+}
+
+void Profiler::beginZone(const char *name) {
+    OpenZone openZone{findZone(name), Clock::now(), gpuTimerSupported_ && !gpuZoneOpen_};
+    if (openZone.gpu) {
+        GLuint query = acquireQuery();
+        glBeginQuery(GL_TIME_ELAPSED_EXT, query);
+        pendingQueries_[frameIndex_ % kQueryLatency].push_back({openZone.zone, query});
+        gpuZoneOpen_ = true;
+    }
+    openZones_.push_back(openZone);
+}
+
+void Profiler::endZone() {
+    assert(!openZones_.empty());
+    auto openZone = openZones_.back();
+    openZones_.pop_back();
+    if (openZone.gpu) {
+        glEndQuery(GL_TIME_ELAPSED_EXT);
+        gpuZoneOpen_ = false;
+    }
+    std::chrono::duration<float, std::milli> zoneTime = Clock::now() - openZone.start;
+    zones_[openZone.zone].cpu.add(zoneTime.count());
+}
+
+std::vector<ZoneStats> Profiler::getStats() const {
+    std::vector<ZoneStats> stats;
+    stats.reserve(zones_.size());
+    for (const auto &zone: zones_) {
+        stats.push_back({zone.name, zone.cpu.compute(), zone.gpu.compute()});
+    }
+    return stats;
+}
+
+bool Profiler::dumpStats(const std::string &path) const {
+    std::ofstream out(path);
+    if (!out) {
+        aout << "[ERROR] Failed to write frame stats to " << path << std::endl;
+        return false;
+    }
+    out << "zone,cpu_samples,cpu_min,cpu_avg,cpu_p95,cpu_p99,"
+           "gpu_samples,gpu_min,gpu_avg,gpu_p95,gpu_p99\n";
+    for (const auto &zone: getStats()) {
+        out << zone.name << ","
+            << zone.cpu.samples << "," << zone.cpu.min << "," << zone.cpu.avg << ","
+            << zone.cpu.p95 << "," << zone.cpu.p99 << ","
+            << zone.gpu.samples << "," << zone.gpu.min << "," << zone.gpu.avg << ","
+            << zone.gpu.p95 << "," << zone.gpu.p99 << "\n";
+    }
+    return static_cast<bool>(out);
+}
+
+size_t Profiler::findZone(const char *name) {
+    for (size_t i = 0; i < zones_.size(); i++) {
+        if (zones_[i].name == name) {
+            return i;
+        }
+    }
+    zones_.push_back({name, {}, {}});
+    return zones_.size() - 1;
+}
+
+GLuint Profiler::acquireQuery() {
+    if (freeQueries_.empty()) {
+        GLuint query;
+        glGenQueries(1, &query);
+        allQueries_.push_back(query);
+        return query;
+    }
+    GLuint query = freeQueries_.back();
+    freeQueries_.pop_back();
+    return query;
+}
+
+void Profiler::History::add(float value) {
+    if (samples.size() < kHistorySize) {
+        samples.push_back(value);
+    } else {
+        samples[next] = value;
+    }
+    next = (next + 1) % kHistorySize;
+}
+
+ZoneStats::Timings Profiler::History::compute() const {
+    ZoneStats::Timings timings;
+    if (samples.empty()) {
+        return timings;
+    }
+
+    std::vector<float> sorted(samples);
+    std::sort(sorted.begin(), sorted.end());
+    auto percentile = [&sorted](float p) {
+        auto rank = static_cast<size_t>(std::ceil(p * sorted.size()));
+        return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+    };
+
+    float total = 0.f;
+    for (auto sample: sorted) {
+        total += sample;
+    }
+    timings.min = sorted.front();
+    timings.avg = total / sorted.size();
+    timings.p95 = percentile(0.95f);
+    timings.p99 = percentile(0.99f);
+    timings.samples = sorted.size();
+    return timings;
+}
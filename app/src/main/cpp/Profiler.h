@@ -0,0 +1,164 @@
+#ifndef ANDROIDGLINVESTIGATIONS_PROFILER_H
+#define ANDROIDGLINVESTIGATIONS_PROFILER_H
+
+#include <GLES3/gl31.h>
+#include <GLES2/gl2ext.h>
+#include <array>
+#include <chrono>
+#include <string>
+#include <vector>
+
+/*!
+ * Rolling statistics of one timing zone, all times in milliseconds
+ */
+struct ZoneStats {
+    struct Timings {
+        float min = 0.f;
+        float avg = 0.f;
+        float p95 = 0.f;
+        float p99 = 0.f;
+        size_t samples = 0;
+    };
+
+    std::string name;
+    Timings cpu;
+    Timings gpu;
+};
+
+/*!
+ * Collects CPU and GPU times of named zones per frame. CPU time is taken with a steady clock. GPU
+ * time uses GL_EXT_disjoint_timer_query when it's available: every frame gets its own set of
+ * query objects and the results are read back @a kQueryLatency frames later, so the render thread
+ * never waits for the GPU. Frames where the GPU reported a disjoint event are dropped.
+ *
+ * GPU queries of the same target can't nest, so only top level zones are timed on the GPU. Nested
+ * zones get CPU timing only.
+ */
+class Profiler {
+public:
+    /*!
+     * Number of frames between issuing a GPU query and reading it back
+     */
+    static constexpr size_t kQueryLatency = 4;
+
+    /*!
+     * Number of samples kept per zone for the rolling statistics
+     */
+    static constexpr size_t kHistorySize = 256;
+
+    /*!
+     * Name of the implicit zone covering everything between @a beginFrame and @a endFrame. Its GPU
+     * time is the sum of the top level zones of the frame, GPU work outside of zones isn't in it.
+     */
+    static constexpr const char *kFrameZone = "Frame";
+
+    Profiler() = default;
+
+    ~Profiler();
+
+    Profiler(const Profiler &) = delete;
+
+    Profiler &operator=(const Profiler &) = delete;
+
+    /*!
+     * Checks for timer query support, requires a current GL context
+     */
+    void init();
+
+    /*!
+     * Reads back the GPU results of the frame that used this query slot last
+     */
+    void beginFrame();
+
+    void endFrame();
+
+    void beginZone(const char *name);
+
+    void endZone();
+
+    /*!
+     * @return true if the zones are timed on the GPU too
+     */
+    bool hasGpuTimer() const { return gpuTimerSupported_; }
+
+    /*!
+     * @return the rolling min/avg/p95/p99 of every zone seen so far, in first-seen order
+     */
+    std::vector<ZoneStats> getStats() const;
+
+    /*!
+     * Writes @a getStats as CSV
+     * @param path the file to write
+     * @return false if the file couldn't be written
+     */
+    bool dumpStats(const std::string &path) const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct History {
+        void add(float value);
+
+        ZoneStats::Timings compute() const;
+
+        std::vector<float> samples;
+        size_t next = 0;
+    };
+
+    struct Zone {
+        std::string name;
+        History cpu;
+        History gpu;
+    };
+
+    struct OpenZone {
+        size_t zone;
+        Clock::time_point start;
+        bool gpu;
+    };
+
+    struct PendingQuery {
+        size_t zone;
+        GLuint query;
+    };
+
+    size_t findZone(const char *name);
+
+    GLuint acquireQuery();
+
+    bool gpuTimerSupported_ = false;
+    PFNGLGETQUERYOBJECTUI64VEXTPROC glGetQueryObjectui64vEXT_ = nullptr;
+
+    std::vector<Zone> zones_;
+    std::vector<OpenZone> openZones_;
+    Clock::time_point frameStart_;
+    bool gpuZoneOpen_ = false;
+
+    uint64_t frameIndex_ = 0;
+    std::array<std::vector<PendingQuery>, kQueryLatency> pendingQueries_;
+    std::vector<GLuint> freeQueries_;
+    std::vector<GLuint> allQueries_;
+};
+
+/*!
+ * Times the enclosing scope as a zone of @a profiler
+ */
+class ScopedZone {
+public:
+    inline ScopedZone(Profiler &profiler, const char *name) : profiler_(profiler) {
+        profiler_.beginZone(name);
+    }
+
+    inline ~ScopedZone() {
+        profiler_.endZone();
+    }
+
+    ScopedZone(const ScopedZone &) = delete;
+
+    ScopedZone &operator=(const ScopedZone &) = delete;
+
+private:
+    Profiler &profiler_;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_PROFILER_H
@@ -0,0 +1,161 @@
+#include "ProgramCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+#include "AndroidOut.h"
+#include "GLStateCache.h"
+
+ProgramCache::ProgramCache(std::string directory) : directory_(std::move(directory)) {}
+
+void ProgramCache::init() {
+    if (directory_.empty()) {
+        return;
+    }
+
+    GLint formatCount = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+    if (formatCount == 0) {
+        aout << "Program cache disabled, the driver has no program binary formats" << std::endl;
+        return;
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(directory_, error);
+    if (error) {
+        aout << "[ERROR] Program cache disabled, can't create " << directory_ << ": "
+             << error.message() << std::endl;
+        return;
+    }
+
+    for (GLenum name: {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+        auto value = reinterpret_cast<const char *>(glGetString(name));
+        driver_ += value ? value : "";
+        driver_ += '\n';
+    }
+    enabled_ = true;
+}
+
+GLuint ProgramCache::load(const std::vector<std::string> &sources) {
+    if (!enabled_) {
+        return 0;
+    }
+
+    uint64_t key = computeKey(sources);
+    std::string path = pathFor(key);
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        misses_++;
+        return 0;
+    }
+    std::vector<char> contents((std::istreambuf_iterator<char>(file)),
+                               std::istreambuf_iterator<char>());
+    file.close();
+
+    Header header{};
+    bool intact = contents.size() >= sizeof(Header);
+    if (intact) {
+        memcpy(&header, contents.data(), sizeof(Header));
+        intact = header.magic == kMagic
+                 && header.version == kVersion
+                 && header.key == key
+                 && header.binaryLength == contents.size() - sizeof(Header)
+                 && header.checksum == hash(contents.data() + sizeof(Header), header.binaryLength);
+    }
+    if (!intact) {
+        aout << "[ERROR] Discarding damaged program binary " << path << std::endl;
+        std::remove(path.c_str());
+        misses_++;
+        return 0;
+    }
+
+    GLuint program = glCreateProgram();
+    glProgramBinary(program, header.binaryFormat, contents.data() + sizeof(Header),
+                    static_cast<GLsizei>(header.binaryLength));
+    GLint linkStatus = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
+    if (linkStatus != GL_TRUE) {
+        // drivers may reject their own binaries, e.g. after an update that kept the version string
+        aout << "Driver rejected program binary " << path << ", recompiling" << std::endl;
+        glState.deleteProgram(program);
+        std::remove(path.c_str());
+        misses_++;
+        return 0;
+    }
+    hits_++;
+    return program;
+}
+
+void ProgramCache::store(const std::vector<std::string> &sources, GLuint program) {
+    if (!enabled_) {
+        return;
+    }
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+    std::vector<char> binary(length);
+    GLenum binaryFormat = 0;
+    glGetProgramBinary(program, length, &length, &binaryFormat, binary.data());
+
+    Header header{};
+    header.magic = kMagic;
+    header.version = kVersion;
+    header.key = computeKey(sources);
+    header.binaryFormat = binaryFormat;
+    header.binaryLength = static_cast<uint32_t>(length);
+    header.checksum = hash(binary.data(), length);
+
+    // write next to the target and rename, so a crash never leaves a truncated file behind
+    std::string path = pathFor(header.key);
+    std::string temporaryPath = path + ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char *>(&header), sizeof(Header));
+        file.write(binary.data(), length);
+        if (!file) {
+            aout << "[ERROR] Can't write program binary " << temporaryPath << std::endl;
+            file.close();
+            std::remove(temporaryPath.c_str());
+            return;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temporaryPath, path, error);
+    if (error) {
+        aout << "[ERROR] Can't store program binary " << path << ": " << error.message()
+             << std::endl;
+        std::remove(temporaryPath.c_str());
+    }
+}
+
+uint64_t ProgramCache::computeKey(const std::vector<std::string> &sources) const {
+    uint64_t key = hash(driver_.data(), driver_.size());
+    for (const auto &source: sources) {
+        // include the length so moving text between stages changes the key
+        uint64_t length = source.size();
+        key = hash(&length, sizeof(length), key);
+        key = hash(source.data(), source.size(), key);
+    }
+    return key;
+}
+
+std::string ProgramCache::pathFor(uint64_t key) const {
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+    return (std::filesystem::path(directory_) / name).string();
+}
+
+uint64_t ProgramCache::hash(const void *data, size_t length, uint64_t hash) {
+    auto bytes = static_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
@@ -0,0 +1,80 @@
+#ifndef ANDROIDGLINVESTIGATIONS_PROGRAMCACHE_H
+#define ANDROIDGLINVESTIGATIONS_PROGRAMCACHE_H
+
+#include <GLES3/gl31.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*!
+ * Stores linked programs as glGetProgramBinary blobs, one file per program, so later launches
+ * skip compiling and linking GLSL.
+ *
+ * A program's file name is a hash of its sources together with GL_VENDOR, GL_RENDERER and
+ * GL_VERSION, so editing a shader or updating the driver misses the cache instead of feeding the
+ * driver a stale binary. Every file carries a checksum of the binary; a damaged file, or a binary
+ * the driver rejects anyway, is deleted and the caller recompiles from source.
+ */
+class ProgramCache {
+public:
+    /*!
+     * @param directory where the binaries are stored, created on demand. Empty disables the cache.
+     */
+    explicit ProgramCache(std::string directory = "");
+
+    /*!
+     * Reads the driver identification. Needs a current context.
+     */
+    void init();
+
+    /*!
+     * @return false if there is no directory or the driver supports no binary formats
+     */
+    bool isEnabled() const { return enabled_; }
+
+    /*!
+     * @param sources every stage's source, in a fixed order
+     * @return a linked program created from the cached binary, 0 on a miss
+     */
+    GLuint load(const std::vector<std::string> &sources);
+
+    /*!
+     * Saves a linked program. It should be linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT.
+     * @param sources the sources the program was built from, as passed to @a load
+     */
+    void store(const std::vector<std::string> &sources, GLuint program);
+
+    int getHits() const { return hits_; }
+
+    int getMisses() const { return misses_; }
+
+private:
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t key;
+        uint32_t binaryFormat;
+        uint32_t binaryLength;
+        uint64_t checksum;
+    };
+
+    static constexpr uint32_t kMagic = 0x4E494250; // "PBIN"
+    static constexpr uint32_t kVersion = 1;
+
+    uint64_t computeKey(const std::vector<std::string> &sources) const;
+
+    std::string pathFor(uint64_t key) const;
+
+    /*!
+     * 64 bit FNV-1a, continuing from @a hash
+     */
+    static uint64_t hash(const void *data, size_t length, uint64_t hash = 14695981039346656037ull);
+
+    std::string directory_;
+    std::string driver_;
+    bool enabled_ = false;
+    int hits_ = 0;
+    int misses_ = 0;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_PROGRAMCACHE_H
@@ -0,0 +1,351 @@
+#include "RenderGraph.h"
+
+#include <cassert>
+
+#include "GLStateCache.h"
+
+RenderGraph::Pass &RenderGraph::Pass::read(Resource resource, Access access) {
+    uses_.push_back({resource, access, false});
+    return *this;
+}
+
+RenderGraph::Pass &RenderGraph::Pass::write(Resource resource, Access access) {
+    uses_.push_back({resource, access, true});
+    return *this;
+}
+
+RenderGraph::Pass &RenderGraph::Pass::colorAttachment(Resource resource, LoadOp loadOp) {
+    color_ = resource;
+    colorLoad_ = loadOp;
+    if (loadOp == LoadOp::Load) {
+        read(resource, Access::ColorAttachment);
+    }
+    return write(resource, Access::ColorAttachment);
+}
+
+RenderGraph::Pass &RenderGraph::Pass::depthAttachment(Resource resource, LoadOp loadOp) {
+    depth_ = resource;
+    depthLoad_ = loadOp;
+    if (loadOp == LoadOp::Load) {
+        read(resource, Access::DepthAttachment);
+    }
+    return write(resource, Access::DepthAttachment);
+}
+
+RenderGraph::~RenderGraph() {
+    for (auto &framebuffer: framebuffers_) {
+        glState.deleteFramebuffers(1, &framebuffer.second.first);
+    }
+}
+
+void RenderGraph::beginFrame() {
+    resources_.clear();
+    passes_.clear();
+    frameIndex_++;
+}
+
+RenderGraph::Resource RenderGraph::createTexture(const char *name, const TextureDesc &desc) {
+    ResourceNode node;
+    node.name = name;
+    node.desc = desc;
+    resources_.push_back(node);
+    return static_cast<Resource>(resources_.size() - 1);
+}
+
+RenderGraph::Resource RenderGraph::importTexture(const char *name, GLuint texture,
+                                                 const TextureDesc &desc, bool retained) {
+    Resource resource = createTexture(name, desc);
+    resources_[resource].texture = texture;
+    resources_[resource].imported = true;
+    resources_[resource].retained = retained;
+    return resource;
+}
+
+RenderGraph::Resource RenderGraph::importBuffer(const char *name, bool retained) {
+    ResourceNode node;
+    node.name = name;
+    node.imported = true;
+    node.retained = retained;
+    resources_.push_back(node);
+    return static_cast<Resource>(resources_.size() - 1);
+}
+
+RenderGraph::Resource RenderGraph::importBackbuffer(int width, int height) {
+    Resource resource = importTexture("Backbuffer", 0, {GL_RGBA8, width, height}, true);
+    resources_[resource].backbuffer = true;
+    return resource;
+}
+
+RenderGraph::Pass &RenderGraph::addPass(const char *name, std::function<void()> execute) {
+    passes_.emplace_back();
+    passes_.back().name_ = name;
+    passes_.back().execute_ = std::move(execute);
+    return passes_.back();
+}
+
+GLuint RenderGraph::getTexture(Resource resource) const {
+    return resources_[resource].texture;
+}
+
+void RenderGraph::execute(Profiler &profiler) {
+    cullPasses();
+
+    for (size_t i = 0; i < passes_.size(); i++) {
+        if (!passes_[i].alive_) {
+            continue;
+        }
+        for (const auto &use: passes_[i].uses_) {
+            auto &node = resources_[use.resource];
+            if (node.firstPass < 0) {
+                node.firstPass = static_cast<int>(i);
+            }
+            node.lastPass = static_cast<int>(i);
+            node.usage |= usageFor(use.access);
+        }
+    }
+
+    barrierStates_.assign(resources_.size(), {});
+    for (size_t r = 0; r < resources_.size(); r++) {
+        if (resources_[r].retained) {
+            barrierStates_[r] = retainedStates_[resources_[r].name];
+        }
+    }
+
+    for (size_t i = 0; i < passes_.size(); i++) {
+        const auto &pass = passes_[i];
+        if (!pass.alive_) {
+            continue;
+        }
+
+        for (auto &node: resources_) {
+            if (!node.imported && node.firstPass == static_cast<int>(i)) {
+                node.texture = renderTargets_.acquire(
+                        {node.desc.format, node.desc.width, node.desc.height, node.usage});
+            }
+        }
+
+        // one barrier covering every incoherent write this pass consumes
+        GLbitfield barriers = 0;
+        for (const auto &use: pass.uses_) {
+            const auto &state = barrierStates_[use.resource];
+            if (state.incoherentWrite) {
+                barriers |= barrierFor(use.access) & ~state.issued;
+            }
+        }
+        if (barriers) {
+            glMemoryBarrier(barriers);
+            for (auto &state: barrierStates_) {
+                state.issued |= barriers;
+            }
+        }
+
+        {
+            ScopedZone zone(profiler, pass.name_.c_str());
+            bool raster = pass.color_ != kInvalidResource || pass.depth_ != kInvalidResource;
+            if (raster) {
+                beginRasterPass(pass);
+            }
+            pass.execute_();
+            if (raster) {
+                endRasterPass(pass, static_cast<int>(i));
+            }
+        }
+
+        for (const auto &use: pass.uses_) {
+            if (use.write && isIncoherentWrite(use.access)) {
+                barrierStates_[use.resource] = {true, 0};
+            }
+        }
+
+        for (auto &node: resources_) {
+            if (!node.imported && node.lastPass == static_cast<int>(i)) {
+                renderTargets_.release(node.texture);
+            }
+        }
+    }
+
+    for (size_t r = 0; r < resources_.size(); r++) {
+        if (resources_[r].retained) {
+            retainedStates_[resources_[r].name] = barrierStates_[r];
+        }
+    }
+
+    collectGarbage();
+}
+
+void RenderGraph::cullPasses() {
+    // Walk backwards from the outputs: a pass is needed if it writes something a later needed
+    // pass reads, or something that outlives the frame
+    std::vector<bool> needed(resources_.size());
+    for (size_t r = 0; r < resources_.size(); r++) {
+        needed[r] = resources_[r].retained;
+    }
+
+    culledPasses_ = 0;
+    for (auto pass = passes_.rbegin(); pass != passes_.rend(); ++pass) {
+        pass->alive_ = false;
+        for (const auto &use: pass->uses_) {
+            pass->alive_ |= use.write && needed[use.resource];
+        }
+        if (!pass->alive_) {
+            culledPasses_++;
+            continue;
+        }
+        for (const auto &use: pass->uses_) {
+            if (!use.write) {
+                needed[use.resource] = true;
+            }
+        }
+    }
+}
+
+GLuint RenderGraph::getFramebuffer(const Pass &pass) {
+    GLuint color = pass.color_ != kInvalidResource ? resources_[pass.color_].texture : 0;
+    GLuint depth = pass.depth_ != kInvalidResource ? resources_[pass.depth_].texture : 0;
+    if (pass.color_ != kInvalidResource && resources_[pass.color_].backbuffer) {
+        assert(pass.depth_ == kInvalidResource);
+        return 0;
+    }
+
+    auto &framebuffer = framebuffers_[{color, depth}];
+    if (!framebuffer.first) {
+        glGenFramebuffers(1, &framebuffer.first);
+        glState.bindFramebuffer(framebuffer.first);
+        if (color) {
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color, 0);
+        }
+        if (depth) {
+            glFramebufferTexture2D(GL_FRAMEBUFFER, attachmentPoint(resources_[pass.depth_], true),
+                                   GL_TEXTURE_2D, depth, 0);
+        }
+    }
+    framebuffer.second = frameIndex_;
+    return framebuffer.first;
+}
+
+void RenderGraph::beginRasterPass(const Pass &pass) {
+    glState.bindFramebuffer(getFramebuffer(pass));
+    const auto &target = resources_[pass.color_ != kInvalidResource ? pass.color_ : pass.depth_];
+    glState.viewport(0, 0, target.desc.width, target.desc.height);
+
+    GLbitfield clearBits = 0;
+    std::vector<GLenum> discard;
+    if (pass.color_ != kInvalidResource) {
+        if (pass.colorLoad_ == LoadOp::Clear) {
+            clearBits |= GL_COLOR_BUFFER_BIT;
+        } else if (pass.colorLoad_ == LoadOp::DontCare) {
+            discard.push_back(attachmentPoint(resources_[pass.color_], false));
+        }
+    }
+    if (pass.depth_ != kInvalidResource) {
+        const auto &depth = resources_[pass.depth_];
+        if (pass.depthLoad_ == LoadOp::Clear) {
+            // glClear honors the depth mask, a pass may have left it off
+            glState.depthMask(true);
+            clearBits |= attachmentPoint(depth, true) == GL_DEPTH_STENCIL_ATTACHMENT
+                         ? GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT
+                         : GL_DEPTH_BUFFER_BIT;
+        } else if (pass.depthLoad_ == LoadOp::DontCare) {
+            discard.push_back(attachmentPoint(depth, true));
+        }
+    }
+    if (!discard.empty()) {
+        glInvalidateFramebuffer(GL_FRAMEBUFFER, static_cast<GLsizei>(discard.size()), discard.data());
+    }
+    if (clearBits) {
+        glClear(clearBits);
+    }
+}
+
+void RenderGraph::endRasterPass(const Pass &pass, int passIndex) {
+    // attachments nobody uses after this pass don't need to be stored
+    std::vector<GLenum> discard;
+    for (bool depth: {false, true}) {
+        Resource attachment = depth ? pass.depth_ : pass.color_;
+        if (attachment == kInvalidResource) {
+            continue;
+        }
+        const auto &node = resources_[attachment];
+        if (!node.retained && node.lastPass == passIndex) {
+            discard.push_back(attachmentPoint(node, depth));
+        }
+    }
+    if (pass.color_ != kInvalidResource && resources_[pass.color_].backbuffer) {
+        // the graph never hands out the default framebuffer's depth and stencil
+        discard.push_back(GL_DEPTH);
+        discard.push_back(GL_STENCIL);
+    }
+    if (!discard.empty()) {
+        glInvalidateFramebuffer(GL_FRAMEBUFFER, static_cast<GLsizei>(discard.size()), discard.data());
+    }
+    // the framebuffer stays bound, the next raster pass binds its own
+}
+
+void RenderGraph::collectGarbage() {
+    // a framebuffer unused for a frame goes before the pool can delete a texture it references
+    for (auto it = framebuffers_.begin(); it != framebuffers_.end();) {
+        if (it->second.second != frameIndex_) {
+            glState.deleteFramebuffers(1, &it->second.first);
+            it = framebuffers_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+GLbitfield RenderGraph::barrierFor(Access access) {
+    switch (access) {
+        case Access::Sampled:
+            return GL_TEXTURE_FETCH_BARRIER_BIT;
+        case Access::ImageLoad:
+        case Access::ImageStore:
+            return GL_SHADER_IMAGE_ACCESS_BARRIER_BIT;
+        case Access::StorageRead:
+        case Access::StorageWrite:
+            return GL_SHADER_STORAGE_BARRIER_BIT;
+        case Access::IndirectRead:
+            return GL_COMMAND_BARRIER_BIT;
+        case Access::IndexRead:
+            return GL_ELEMENT_ARRAY_BARRIER_BIT;
+        case Access::ColorAttachment:
+        case Access::DepthAttachment:
+            return GL_FRAMEBUFFER_BARRIER_BIT;
+    }
+    return 0;
+}
+
+bool RenderGraph::isIncoherentWrite(Access access) {
+    // framebuffer writes are ordered by GL itself, shader side effects are not
+    return access == Access::ImageStore || access == Access::StorageWrite;
+}
+
+GLenum RenderGraph::attachmentPoint(const ResourceNode &node, bool depth) {
+    if (node.backbuffer) {
+        return depth ? GL_DEPTH : GL_COLOR;
+    }
+    if (!depth) {
+        return GL_COLOR_ATTACHMENT0;
+    }
+    bool stencil = node.desc.format == GL_DEPTH24_STENCIL8 || node.desc.format == GL_DEPTH32F_STENCIL8;
+    return stencil ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
+}
+
+uint32_t RenderGraph::usageFor(Access access) {
+    switch (access) {
+        case Access::Sampled:
+            return RenderTargetPool::kUsageSampled;
+        case Access::ImageLoad:
+        case Access::ImageStore:
+        case Access::StorageRead:
+        case Access::StorageWrite:
+            return RenderTargetPool::kUsageStorage;
+        case Access::IndirectRead:
+        case Access::IndexRead:
+            return 0;
+        case Access::ColorAttachment:
+            return RenderTargetPool::kUsageColorAttachment;
+        case Access::DepthAttachment:
+            return RenderTargetPool::kUsageDepthAttachment;
+    }
+    return 0;
+}
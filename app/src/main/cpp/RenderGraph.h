@@ -0,0 +1,228 @@
+#ifndef ANDROIDGLINVESTIGATIONS_RENDERGRAPH_H
+#define ANDROIDGLINVESTIGATIONS_RENDERGRAPH_H
+
+#include <GLES3/gl31.h>
+#include <deque>
+#include <functional>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Profiler.h"
+#include "RenderTargetPool.h"
+
+/*!
+ * A frame graph rebuilt every frame. Passes declare which resources they read and write and how,
+ * the graph then
+ *  - culls passes whose results nobody consumes,
+ *  - issues the glMemoryBarrier bits each pass needs after incoherent image and storage writes,
+ *  - acquires transient targets from a RenderTargetPool for their first pass and releases them
+ *    after their last, so targets whose lifetimes don't overlap share a texture,
+ *  - binds the framebuffer of raster passes, applies their load ops and invalidates attachments
+ *    nobody reads afterwards, so tilers neither load nor store them.
+ *
+ * Imported resources live outside the graph. Retained ones (persistent pyramids, indirect buffers,
+ * the backbuffer) count as frame outputs, and their pending barriers carry over to the next frame.
+ */
+class RenderGraph {
+public:
+    /*!
+     * Index of a resource, valid for the frame it was created in
+     */
+    using Resource = int;
+
+    static constexpr Resource kInvalidResource = -1;
+
+    struct TextureDesc {
+        GLenum format = GL_RGBA8;
+        int width = 0;
+        int height = 0;
+
+        bool operator==(const TextureDesc &other) const {
+            return format == other.format && width == other.width && height == other.height;
+        }
+    };
+
+    /*!
+     * How a pass accesses a resource
+     */
+    enum class Access {
+        Sampled,
+        ImageLoad,
+        ImageStore,
+        StorageRead,
+        StorageWrite,
+        IndirectRead,
+        IndexRead,
+        ColorAttachment,
+        DepthAttachment
+    };
+
+    /*!
+     * What a raster pass does with an attachment's previous contents
+     */
+    enum class LoadOp {
+        Load,
+        /*!
+         * Cleared with the current clear color / depth
+         */
+        Clear,
+        /*!
+         * Every pixel gets overwritten, the old contents are invalidated
+         */
+        DontCare
+    };
+
+    class Pass {
+    public:
+        Pass &read(Resource resource, Access access);
+
+        Pass &write(Resource resource, Access access);
+
+        /*!
+         * Renders into @a resource, making this a raster pass
+         */
+        Pass &colorAttachment(Resource resource, LoadOp loadOp);
+
+        Pass &depthAttachment(Resource resource, LoadOp loadOp);
+
+    private:
+        friend class RenderGraph;
+
+        struct Use {
+            Resource resource;
+            Access access;
+            bool write;
+        };
+
+        std::string name_;
+        std::function<void()> execute_;
+        std::vector<Use> uses_;
+        Resource color_ = kInvalidResource;
+        Resource depth_ = kInvalidResource;
+        LoadOp colorLoad_ = LoadOp::Load;
+        LoadOp depthLoad_ = LoadOp::Load;
+        bool alive_ = false;
+    };
+
+    /*!
+     * @param renderTargets where transient textures come from
+     */
+    explicit RenderGraph(RenderTargetPool &renderTargets) : renderTargets_(renderTargets) {}
+
+    ~RenderGraph();
+
+    RenderGraph(const RenderGraph &) = delete;
+
+    RenderGraph &operator=(const RenderGraph &) = delete;
+
+    /*!
+     * Drops the passes and resources of the last frame
+     */
+    void beginFrame();
+
+    /*!
+     * A texture that only lives during this frame, allocated by the graph
+     */
+    Resource createTexture(const char *name, const TextureDesc &desc);
+
+    /*!
+     * @param retained true if the contents are used after this frame
+     */
+    Resource importTexture(const char *name, GLuint texture, const TextureDesc &desc, bool retained);
+
+    /*!
+     * A buffer (or a group of buffers) whose accesses the graph orders, it never binds it
+     */
+    Resource importBuffer(const char *name, bool retained);
+
+    /*!
+     * The default framebuffer's color buffer. Its depth and stencil are invalidated after use.
+     */
+    Resource importBackbuffer(int width, int height);
+
+    /*!
+     * @param execute records the pass' GL work. Raster passes run with their framebuffer bound.
+     * @return the pass to declare the resource accesses on, valid until the next beginFrame
+     */
+    Pass &addPass(const char *name, std::function<void()> execute);
+
+    /*!
+     * @return the GL texture of a texture resource, only valid while its passes execute
+     */
+    GLuint getTexture(Resource resource) const;
+
+    /*!
+     * Culls, allocates and runs the passes in the order they were added, each in a profiler zone
+     */
+    void execute(Profiler &profiler);
+
+    /*!
+     * @return the number of passes culled from the last executed frame
+     */
+    int getCulledPassCount() const { return culledPasses_; }
+
+private:
+    struct ResourceNode {
+        std::string name;
+        TextureDesc desc;
+        GLuint texture = 0;
+        bool imported = false;
+        bool retained = false;
+        bool backbuffer = false;
+        int firstPass = -1;
+        int lastPass = -1;
+        /*!
+         * RenderTargetPool::Usage bits of all accesses
+         */
+        uint32_t usage = 0;
+    };
+
+    /*!
+     * Barrier state of a resource: set when an incoherent write happened, cleared per barrier bit
+     * as barriers get issued
+     */
+    struct BarrierState {
+        bool incoherentWrite = false;
+        GLbitfield issued = 0;
+    };
+
+    void cullPasses();
+
+    GLuint getFramebuffer(const Pass &pass);
+
+    void beginRasterPass(const Pass &pass);
+
+    void endRasterPass(const Pass &pass, int passIndex);
+
+    void collectGarbage();
+
+    static GLbitfield barrierFor(Access access);
+
+    static uint32_t usageFor(Access access);
+
+    static bool isIncoherentWrite(Access access);
+
+    static GLenum attachmentPoint(const ResourceNode &node, bool depth);
+
+    std::vector<ResourceNode> resources_;
+    std::vector<BarrierState> barrierStates_;
+    // a deque so the references addPass hands out stay valid
+    std::deque<Pass> passes_;
+    int culledPasses_ = 0;
+
+    /*!
+     * Barrier state of retained imports, by name, carried into the next frame
+     */
+    std::unordered_map<std::string, BarrierState> retainedStates_;
+
+    RenderTargetPool &renderTargets_;
+    /*!
+     * Framebuffers by (color texture, depth texture), and the frame they were last used in
+     */
+    std::map<std::pair<GLuint, GLuint>, std::pair<GLuint, uint64_t>> framebuffers_;
+    uint64_t frameIndex_ = 0;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_RENDERGRAPH_H
@@ -0,0 +1,89 @@
+#include "RenderTargetPool.h"
+
+#include <algorithm>
+
+#include "AndroidOut.h"
+#include "GLStateCache.h"
+
+RenderTargetPool::~RenderTargetPool() {
+    for (auto &target: targets_) {
+        glState.deleteTextures(1, &target.texture);
+    }
+}
+
+GLuint RenderTargetPool::acquire(const Desc &desc) {
+    for (auto &target: targets_) {
+        if (!target.inUse && target.desc == desc) {
+            target.inUse = true;
+            target.lastUsedFrame = frameIndex_;
+            return target.texture;
+        }
+    }
+
+    Target target;
+    target.desc = desc;
+    target.bytes = bytesPerPixel(desc.format) * desc.width * desc.height;
+    target.lastUsedFrame = frameIndex_;
+    target.inUse = true;
+
+    glGenTextures(1, &target.texture);
+    glState.bindTexture(0, GL_TEXTURE_2D, target.texture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, desc.format, desc.width, desc.height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    // depth and storage targets are read texel by texel, color may get resampled
+    GLint filter = desc.usage & (kUsageDepthAttachment | kUsageStorage) ? GL_NEAREST : GL_LINEAR;
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+    glState.bindTexture(0, GL_TEXTURE_2D, 0);
+
+    liveBytes_ += target.bytes;
+    peakBytes_ = std::max(peakBytes_, liveBytes_);
+    targets_.push_back(target);
+    return target.texture;
+}
+
+void RenderTargetPool::release(GLuint texture) {
+    for (auto &target: targets_) {
+        if (target.texture == texture) {
+            target.inUse = false;
+            return;
+        }
+    }
+    aout << "[ERROR] Released render target " << texture << " isn't from the pool" << std::endl;
+}
+
+void RenderTargetPool::endFrame() {
+    for (auto it = targets_.begin(); it != targets_.end();) {
+        if (!it->inUse && it->lastUsedFrame + releaseFrames_ <= frameIndex_) {
+            glState.deleteTextures(1, &it->texture);
+            liveBytes_ -= it->bytes;
+            it = targets_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    frameIndex_++;
+}
+
+size_t RenderTargetPool::bytesPerPixel(GLenum format) {
+    switch (format) {
+        case GL_R8:
+            return 1;
+        case GL_R16F:
+        case GL_RG8:
+        case GL_DEPTH_COMPONENT16:
+            return 2;
+        case GL_RGBA16F:
+        case GL_RG32F:
+            return 8;
+        case GL_RGBA32F:
+            return 16;
+        case GL_DEPTH32F_STENCIL8:
+            // 32 bit depth plus a separate or padded stencil byte
+            return 8;
+        default:
+            // RGBA8, RGB10_A2, R11F_G11F_B10F, R32F, RG16F, DEPTH24_STENCIL8, DEPTH_COMPONENT32F...
+            return 4;
+    }
+}
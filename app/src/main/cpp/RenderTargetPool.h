@@ -0,0 +1,96 @@
+#ifndef ANDROIDGLINVESTIGATIONS_RENDERTARGETPOOL_H
+#define ANDROIDGLINVESTIGATIONS_RENDERTARGETPOOL_H
+
+#include <GLES3/gl31.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*!
+ * Single level render targets with immutable storage, recycled by (format, size, usage).
+ *
+ * A released target goes back to the pool and is only deleted after it stayed unused for
+ * releaseFrames frames, so targets survive a resize that is undone shortly after (rotating back,
+ * leaving split-screen) and are never deleted while a frame still renders into them.
+ */
+class RenderTargetPool {
+public:
+    /*!
+     * What a target gets used for, part of its key since it decides the sampler state
+     */
+    enum Usage : uint32_t {
+        kUsageSampled = 1 << 0,
+        kUsageColorAttachment = 1 << 1,
+        kUsageDepthAttachment = 1 << 2,
+        kUsageStorage = 1 << 3
+    };
+
+    struct Desc {
+        GLenum format = GL_RGBA8;
+        int width = 0;
+        int height = 0;
+        uint32_t usage = 0;
+
+        bool operator==(const Desc &other) const {
+            return format == other.format && width == other.width && height == other.height
+                   && usage == other.usage;
+        }
+    };
+
+    static constexpr int kDefaultReleaseFrames = 30;
+
+    explicit RenderTargetPool(int releaseFrames = kDefaultReleaseFrames) :
+            releaseFrames_(releaseFrames) {}
+
+    ~RenderTargetPool();
+
+    RenderTargetPool(const RenderTargetPool &) = delete;
+
+    RenderTargetPool &operator=(const RenderTargetPool &) = delete;
+
+    /*!
+     * @return an unused target matching @a desc, allocated if the pool has none
+     */
+    GLuint acquire(const Desc &desc);
+
+    /*!
+     * Returns a target to the pool, its contents are undefined from now on
+     */
+    void release(GLuint texture);
+
+    /*!
+     * Deletes the targets nobody acquired during the last releaseFrames frames
+     */
+    void endFrame();
+
+    /*!
+     * @return the bytes of all targets the pool holds, in use or not
+     */
+    size_t getLiveBytes() const { return liveBytes_; }
+
+    size_t getPeakBytes() const { return peakBytes_; }
+
+    size_t getLiveCount() const { return targets_.size(); }
+
+    /*!
+     * @return the size of one pixel of a sized internal format, as drivers typically store it
+     */
+    static size_t bytesPerPixel(GLenum format);
+
+private:
+    struct Target {
+        Desc desc;
+        GLuint texture = 0;
+        size_t bytes = 0;
+        uint64_t lastUsedFrame = 0;
+        bool inUse = false;
+    };
+
+    int releaseFrames_;
+    std::vector<Target> targets_;
+    uint64_t frameIndex_ = 0;
+    size_t liveBytes_ = 0;
+    size_t peakBytes_ = 0;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_RENDERTARGETPOOL_H
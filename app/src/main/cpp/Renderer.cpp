@@ -1,10 +1,12 @@
 #include "Renderer.h"
 
-#include <game-activity/native_app_glue/android_native_app_glue.h>
 #include <GLES3/gl3.h>
+#include <algorithm>
+#include <chrono>
+#include <iterator>
 #include <memory>
+#include <thread>
 #include <vector>
-#include <android/imagedecoder.h>
 
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/glm.hpp>
@@ -12,6 +14,8 @@
 #include <glm/gtx/transform.hpp>
 
 #include "AndroidOut.h"
+#include "GLStateCache.h"
+#include "JobSystem.h"
 #include "Shader.h"
 #include "Utility.h"
 #include "TextureAsset.h"
@@ -43,22 +47,67 @@ aout << std::endl;\
 
 // Vertex shader, you'd typically load this from assets
 static const char *vertex = R"vertex(#version 300 es
+// FPackedVertex: unorm16 position in the model bounds, octahedral snorm16 normal and tangent
 layout (location=0) in vec3 aPosition;
-layout (location=1) in vec3 aNormal;
+layout (location=1) in vec2 aNormal;
 layout (location=2) in vec2 aTexCoord;
-layout (location=3) in vec3 aTangent;
+layout (location=3) in vec2 aTangent;
+// per instance, see FModel::kInstanceAttribute
+layout (location=4) in mat4 aInstanceWorld;
 
 out vec2 fragUV;
+// the color pass tests GL_EQUAL against the depth prepass, both compute the position alike
+invariant gl_Position;
+
+layout(std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+};
+
+layout(std140) uniform Model {
+    vec4 positionScale;
+    vec4 positionOffset;
+};
 
-uniform mat4 uProjection;
-uniform mat4 uView;
 void main() {
-    vec4 position = vec4(aPosition.xyz, 1.0);
+    vec4 position = aInstanceWorld * vec4(aPosition * positionScale.xyz + positionOffset.xyz, 1.0);
     fragUV = aTexCoord;
-    gl_Position = uProjection * uView * position;
+    gl_Position = viewProjection * position;
 }
 )vertex";
 
+// Vertex shader of the depth prepass, the position of the one above with nothing else
+static const char *depthVertex = R"vertex(#version 300 es
+layout (location=0) in vec3 aPosition;
+layout (location=4) in mat4 aInstanceWorld;
+
+invariant gl_Position;
+
+layout(std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+};
+
+layout(std140) uniform Model {
+    vec4 positionScale;
+    vec4 positionOffset;
+};
+
+void main() {
+    vec4 position = aInstanceWorld * vec4(aPosition * positionScale.xyz + positionOffset.xyz, 1.0);
+    gl_Position = viewProjection * position;
+}
+)vertex";
+
+static const char *depthFragment = R"fragment(#version 300 es
+precision mediump float;
+
+void main() {
+}
+)fragment";
+
 // Fragment shader, you'd typically load this from assets
 static const char *fragment = R"fragment(#version 300 es
 precision mediump float;
@@ -92,6 +141,47 @@ static constexpr float kProjectionNearPlane = -1.f;
  */
 static constexpr float kProjectionFarPlane = 10000.f;
 
+/*!
+ * Near and far plane of the perspective projection
+ */
+static constexpr float kPerspectiveNearPlane = 0.1f;
+static constexpr float kPerspectiveFarPlane = 10000.f;
+
+/*!
+ * The base pass clears depth to 1 and tests with GL_LESS, so the furthest depth is the largest.
+ */
+static constexpr bool kReverseZ = false;
+
+/*!
+ * The per-model constants of the base pass, laid out like its std140 Model block. Streamed every
+ * frame, drawModels binds a model's range to kModelBinding.
+ */
+struct ModelConstants {
+    glm::vec4 positionScale;
+    glm::vec4 positionOffset;
+};
+
+static constexpr GLuint kModelBinding = 1;
+static constexpr const char *kModelBlockName = "Model";
+
+/*!
+ * Bytes streamed per frame: the camera, the constants, visible instances and world bounds of every
+ * model, with room to spare
+ */
+static constexpr GLsizeiptr kStreamRegionSize = 1024 * 1024;
+
+/*!
+ * Render thread time a frame may spend on uploading assets loaded in the background. One upload
+ * always runs, so a bigger one only delays its frame.
+ */
+static constexpr std::chrono::milliseconds kAssetUploadBudget(2);
+
+/*!
+ * Workers loading assets. Reading and decoding is a burst at startup, a few threads cover it and
+ * leave the render thread a core.
+ */
+static constexpr unsigned kMaxAssetLoaderThreads = 4;
+
 Renderer::~Renderer() {
     if (display_ != EGL_NO_DISPLAY) {
         eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
@@ -110,9 +200,9 @@ Renderer::~Renderer() {
 
 void Renderer::initRenderer() {
     // Choose your render attributes
-    constexpr EGLint attribs[] = {
+    const EGLint attribs[] = {
             EGL_RENDERABLE_TYPE, EGL_OPENGL_ES3_BIT,
-            EGL_SURFACE_TYPE, EGL_WINDOW_BIT,
+            EGL_SURFACE_TYPE, platform_->getSurfaceType(),
             EGL_BLUE_SIZE, 8,
             EGL_GREEN_SIZE, 8,
             EGL_RED_SIZE, 8,
@@ -120,8 +210,7 @@ void Renderer::initRenderer() {
             EGL_NONE
     };
 
-    // The default display is probably what you want on Android
-    auto display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    auto display = platform_->getDisplay();
     eglInitialize(display, nullptr, nullptr);
 
     // figure out how many configs there are
@@ -155,10 +244,8 @@ void Renderer::initRenderer() {
     aout << "Found " << numConfigs << " configs" << std::endl;
     aout << "Chose " << config << std::endl;
 
-    // create the proper window surface
-    EGLint format;
-    eglGetConfigAttrib(display, config, EGL_NATIVE_VISUAL_ID, &format);
-    EGLSurface surface = eglCreateWindowSurface(display, config, app_->window, nullptr);
+    // create the surface the platform presents
+    EGLSurface surface = platform_->createSurface(display, config);
 
     // Create a GLES 3 context
     EGLint contextAttribs[] = {EGL_CONTEXT_MAJOR_VERSION, 3, EGL_CONTEXT_MINOR_VERSION, 1, EGL_NONE};
@@ -167,6 +254,8 @@ void Renderer::initRenderer() {
     // get some window metrics
     auto madeCurrent = eglMakeCurrent(display, surface, surface, context);
     assert(madeCurrent);
+    // nothing is known about a new context
+    glState.invalidate();
 
     display_ = display;
     surface_ = surface;
@@ -181,29 +270,37 @@ void Renderer::initRenderer() {
     PRINT_GL_STRING(GL_VERSION);
     PRINT_GL_STRING_AS_LIST(GL_EXTENSIONS);
 
-    basePassShader = std::unique_ptr<Shader>(
-            Shader::loadShader(vertex, fragment));
-    assert(basePassShader);
+    profiler_.init();
+    Stream.init(kStreamRegionSize);
 
-    finalPassShader = std::unique_ptr<Shader>(Shader::loadShader(app_->activity->assetManager, "Shaders/quad.vs", "Shaders/quad.fs"));
-    assert(finalPassShader);
+    shaderStart_ = std::chrono::steady_clock::now();
+    auto cacheDir = platform_->getCacheDir();
+    programCache_ = ProgramCache(cacheDir.empty() ? cacheDir : cacheDir + "/programs");
+    programCache_.init();
 
-    hzbPassShader = std::unique_ptr<Shader>(Shader::loadShader(app_->activity->assetManager, "Shaders/hzb.comp"));
-    assert(hzbPassShader);
+    // Only submit here, the programs are picked up by updatePrograms once the driver is done
+    shaderCompiler_.init(&programCache_);
+    auto &assets = platform_->getAssets();
+    basePassProgram_ = shaderCompiler_.submit(vertex, fragment);
+    depthPrepassProgram_ = shaderCompiler_.submit(depthVertex, depthFragment);
+    finalPassProgram_ = shaderCompiler_.submit(assets, "Shaders/quad.vs", "Shaders/quad.fs");
+    hzbProgram_ = shaderCompiler_.submit(assets, "Shaders/hzb.comp");
+    cullProgram_ = shaderCompiler_.submit(assets, "Shaders/occlusion.comp");
+    meshletProgram_ = shaderCompiler_.submit(assets, "Shaders/meshlet.comp");
 
     // setup any other gl related global states
     glClearColor(CORNFLOWER_BLUE);
 
-    // enable alpha globally for now, you probably don't want to do this in a game
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    // every material is opaque, blending stays off: it reads back every fragment and its result
+    // depends on the draw order
+    glState.setEnabled(GL_BLEND, false);
+
+    // the threads waiting for jobs run jobs too, the workers get the other cores
+    jobSystem.start(std::max(std::thread::hardware_concurrency(), 2u) - 1);
 
     // get some demo models into memory
     createModels();
 
-    // hzb
-    createHZB();
-
     Quad.setup();
 }
 
@@ -217,47 +314,16 @@ void Renderer::updateRenderArea() {
     if (width != width_ || height != height_) {
         width_ = width;
         height_ = height;
-        glViewport(0, 0, width, height);
+        glState.viewport(0, 0, width, height);
 
         // make sure that we lazily recreate the projection matrix before we render
         shaderNeedsNewProjectionMatrix_ = true;
 
-        SceneTexture = CreateTexture(width_, height_, GL_RGBA16F, GL_RGBA, GL_FLOAT);
-
-        {
-            glGenTextures(1, &SceneDepthTexture);
-            glBindTexture(GL_TEXTURE_2D, SceneDepthTexture);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH32F_STENCIL8, width, height, 0, GL_DEPTH_STENCIL, GL_FLOAT_32_UNSIGNED_INT_24_8_REV
-                    , nullptr);  // target, level, internal_format, width, height, border, format, type, data
-            glBindTexture(GL_TEXTURE_2D, 0);
-        }
-
-        glGenFramebuffers(1, &SceneFBO);
-        glBindFramebuffer(GL_FRAMEBUFFER, SceneFBO);
-        glViewport(0, 0, width_, height_);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, SceneDepthTexture, 0);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, SceneTexture, 0);
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        HZBuffer.resize(width_, height_);
+        hzbValid_ = false;
     }
 }
 
-GLuint Renderer::CreateTexture(int width, int height, uint internal_format, uint format, uint size)
-{
-    GLuint texture;
-    glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_2D, texture);
-    glTexImage2D(GL_TEXTURE_2D, 0, internal_format, width, height, 0, format, size, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);  // �ڱ�Եʱ���ظ�
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    return texture;
-}
-
 /**
  * @brief Create any demo models we want for this demo.
  */
@@ -284,100 +350,129 @@ void Renderer::createModels() {
     //
     // Note: there is no texture management in this sample, so if you reuse an image be careful not
     // to load it repeatedly. Since you get a shared_ptr you can safely reuse it in many models.
-    auto assetManager = app_->activity->assetManager;
-    BaseColor = TextureAsset::loadAsset(assetManager, "amenemhat/amenemhat.jpg");
+    //
+    // Until the image is uploaded the models sample a single gray texel.
+    BaseColor = TextureAsset::create({{128, 128, 128, 255}, 1, 1});
+
+    // hardware_concurrency may be 0 if it's unknown
+    unsigned hardwareThreads = std::max(std::thread::hardware_concurrency(), 2u);
+    assetLoader_.start(std::min(hardwareThreads - 1, kMaxAssetLoaderThreads));
+    assetStart_ = std::chrono::steady_clock::now();
+
+    // The jobs only read the asset provider, everything else they touch is their own until the
+    // render thread runs the upload
+    auto &assets = platform_->getAssets();
+    assetLoader_.submit([this, &assets]() -> AssetLoader::Upload {
+        auto image = std::make_shared<TextureAsset::Image>();
+        if (!TextureAsset::decodeAsset(assets, "amenemhat/amenemhat.jpg", *image)) {
+            return nullptr;
+        }
+        return [this, image]() {
+            if (auto texture = TextureAsset::create(*image)) {
+                BaseColor = texture;
+            }
+        };
+    });
 
     // Create a model and put it in the back of the render list.
 //    models_.emplace_back(vertices, indices, spAndroidRobotTexture);
-    models.push_back(FModel::LoadAsset(assetManager, "amenemhat/amenemhat.obj"));
+    assetLoader_.submit([this, &assets]() -> AssetLoader::Upload {
+        auto model = FModel::ImportAsset(assets, "amenemhat/amenemhat.obj");
+        if (!model) {
+            return nullptr;
+        }
+        return [this, model]() {
+            model->GenerateVAO();
+            if (!modelInstances_.empty()) {
+                model->SetInstances(modelInstances_);
+            }
+            modelVisibility.push_back(
+                    std::make_unique<OcclusionCulling::Visibility>(model->GetMeshCount(),
+                                                                  model->GetMeshletCount()));
+            models.push_back(model);
+        };
+    });
 }
 
-void Renderer::handleInput() {
-    // handle all queued inputs
-    auto *inputBuffer = android_app_swap_input_buffers(app_);
-    if (!inputBuffer) {
-        // no inputs yet.
+void Renderer::setModelInstances(std::vector<uint32_t> nodes) {
+    instanceNodes_ = std::move(nodes);
+    instanceNodesChanged_ = true;
+}
+
+void Renderer::updateScene() {
+    ScopedZone zone(profiler_, "SceneUpdate");
+    Scene.Update();
+    if (Scene.GetLastUpdateCount() == 0 && !instanceNodesChanged_) {
         return;
     }
+    instanceNodesChanged_ = false;
+    modelInstances_.clear();
+    for (uint32_t node: instanceNodes_) {
+        modelInstances_.push_back(Scene.GetWorldMatrix(node));
+    }
+    for (auto &model: models) {
+        model->SetInstances(modelInstances_.empty() ? std::vector<glm::mat4>{glm::mat4(1.f)}
+                                                    : modelInstances_);
+    }
+}
 
-    // handle motion events (motionEventsCounts can be 0).
-    for (auto i = 0; i < inputBuffer->motionEventsCount; i++) {
-        auto &motionEvent = inputBuffer->motionEvents[i];
-        auto action = motionEvent.action;
-
-        // Find the pointer index, mask and bitshift to turn it into a readable value.
-        auto pointerIndex = (action & AMOTION_EVENT_ACTION_POINTER_INDEX_MASK)
-                >> AMOTION_EVENT_ACTION_POINTER_INDEX_SHIFT;
-        aout << "Pointer(s): ";
-
-        // get the x and y position of this event if it is not ACTION_MOVE.
-        auto &pointer = motionEvent.pointers[pointerIndex];
-        auto x = GameActivityPointerAxes_getX(&pointer);
-        auto y = GameActivityPointerAxes_getY(&pointer);
+void Renderer::updateAssets() {
+    if (assetsResident_) {
+        return;
+    }
+    ScopedZone zone(profiler_, "AssetUpload");
+    assetLoader_.processUploads(kAssetUploadBudget);
+    if (assetLoader_.getPendingCount() == 0) {
+        auto assetEnd = std::chrono::steady_clock::now();
+        aout << "Assets resident "
+             << std::chrono::duration<double, std::milli>(assetEnd - assetStart_).count()
+             << " ms after submission" << std::endl;
+        assetsResident_ = true;
+    }
+}
 
-        // determine the action type and process the event accordingly.
-        switch (action & AMOTION_EVENT_ACTION_MASK) {
-            case AMOTION_EVENT_ACTION_DOWN:
-            case AMOTION_EVENT_ACTION_POINTER_DOWN:
-                aout << "(" << pointer.id << ", " << x << ", " << y << ") "
-                     << "Pointer Down";
+void Renderer::handleInput() {
+    // handle all queued inputs
+    InputEvents events;
+    platform_->pollInput(events);
+
+    for (const auto &pointerEvent: events.pointerEvents) {
+        aout << "Pointer(s): (" << pointerEvent.pointerId << ", " << pointerEvent.x << ", "
+             << pointerEvent.y << ") ";
+        switch (pointerEvent.action) {
+            case PointerEvent::Action::Down:
+                aout << "Pointer Down";
+                pick(pointerEvent.x, pointerEvent.y);
                 break;
-
-            case AMOTION_EVENT_ACTION_CANCEL:
+            case PointerEvent::Action::Cancel:
                 // treat the CANCEL as an UP event: doing nothing in the app, except
                 // removing the pointer from the cache if pointers are locally saved.
                 // code pass through on purpose.
-            case AMOTION_EVENT_ACTION_UP:
-            case AMOTION_EVENT_ACTION_POINTER_UP:
-                aout << "(" << pointer.id << ", " << x << ", " << y << ") "
-                     << "Pointer Up";
+            case PointerEvent::Action::Up:
+                aout << "Pointer Up";
                 break;
-
-            case AMOTION_EVENT_ACTION_MOVE:
-                // There is no pointer index for ACTION_MOVE, only a snapshot of
-                // all active pointers; app needs to cache previous active pointers
-                // to figure out which ones are actually moved.
-                for (auto index = 0; index < motionEvent.pointerCount; index++) {
-                    pointer = motionEvent.pointers[index];
-                    x = GameActivityPointerAxes_getX(&pointer);
-                    y = GameActivityPointerAxes_getY(&pointer);
-                    aout << "(" << pointer.id << ", " << x << ", " << y << ")";
-
-                    if (index != (motionEvent.pointerCount - 1)) aout << ",";
-                    aout << " ";
-                }
+            case PointerEvent::Action::Move:
                 aout << "Pointer Move";
                 break;
-            default:
-                aout << "Unknown MotionEvent Action: " << action;
         }
         aout << std::endl;
     }
-    // clear the motion input count in this buffer for main thread to re-use.
-    android_app_clear_motion_events(inputBuffer);
 
-    // handle input key events.
-    for (auto i = 0; i < inputBuffer->keyEventsCount; i++) {
-        auto &keyEvent = inputBuffer->keyEvents[i];
-        aout << "Key: " << keyEvent.keyCode <<" ";
+    for (const auto &keyEvent: events.keyEvents) {
+        aout << "Key: " << keyEvent.keyCode << " ";
         switch (keyEvent.action) {
-            case AKEY_EVENT_ACTION_DOWN:
+            case KeyEvent::Action::Down:
                 aout << "Key Down";
                 break;
-            case AKEY_EVENT_ACTION_UP:
+            case KeyEvent::Action::Up:
                 aout << "Key Up";
                 break;
-            case AKEY_EVENT_ACTION_MULTIPLE:
-                // Deprecated since Android API level 29.
+            case KeyEvent::Action::Multiple:
                 aout << "Multiple Key Actions";
                 break;
-            default:
-                aout << "Unknown KeyEvent Action: " << keyEvent.action;
         }
         aout << std::endl;
     }
-    // clear the key input count too.
-    android_app_clear_key_events(inputBuffer);
 }
 
 void Renderer::render() {
@@ -386,95 +481,400 @@ void Renderer::render() {
     // changed.
     updateRenderArea();
 
+    // the passes whose program is still compiling are left out below, the others don't wait
+    updatePrograms();
+    // until the culling programs are in, the meshes are drawn with the commands they were uploaded
+    // with
+    drawMeshlets_ = meshletCulling_ && Culling.hasMeshletCulling();
+    bool depthPrepass = depthPrepass_ && depthPrepassShader;
+
+    profiler_.beginFrame();
+
+    updateAssets();
+
+    updateScene();
+
+    if (shaderNeedsNewProjectionMatrix_) {
+        projectionMatrix_ = glm::perspective(glm::radians(90.0f),
+                                             float(width_) / height_, kPerspectiveNearPlane,
+                                             kPerspectiveFarPlane);
+        // make sure the matrix isn't generated every frame
+        shaderNeedsNewProjectionMatrix_ = false;
+    }
+    glm::mat4 View = glm::translate(glm::vec3(0, 0, -5.0));
+    glm::mat4 viewProjection = projectionMatrix_ * View;
+    viewMatrix_ = View;
+
+    // All per-frame constants go through one mapping of the stream buffer
+    Stream.beginFrame();
+    Camera.update(Stream, {View, projectionMatrix_, viewProjection});
+    modelConstants_.clear();
+    for (const auto &model: models) {
+        auto allocation = Stream.writeUniform(ModelConstants{
+                glm::vec4(model->GetPositionScale(), 0.f),
+                glm::vec4(model->GetPositionOffset(), 0.f)});
+        // the offset of a failed allocation is 0, where the camera's constants are
+        modelConstants_.push_back(allocation ? allocation.offset : kNoModelConstants);
+    }
+
     {
-        // BasePass render
-        basePassShader->activate();
-        glBindFramebuffer(GL_FRAMEBUFFER, SceneFBO);
-        if (shaderNeedsNewProjectionMatrix_) {
-            glm::mat4 projectionMatrix = glm::perspective(glm::radians(90.0f),
-                                                          float(width_) / height_, 0.1f, 10000.0f);
-            basePassShader->Set("uProjection", projectionMatrix);
-            // make sure the matrix isn't generated every frame
-            shaderNeedsNewProjectionMatrix_ = false;
+        // Instances and meshes outside the view never reach the GPU culling or the draw loop, the
+        // others get the LOD of their size on screen
+        ScopedZone zone(profiler_, "FrustumCulling");
+        FFrustum frustum = FFrustum::FromViewProjection(viewProjection);
+        glm::vec3 viewOrigin = glm::vec3(glm::inverse(View)[3]);
+        triangleStats_ = {};
+        for (auto &model: models) {
+            model->FrustumCull(frustum, viewOrigin, projectionMatrix_[1][1]);
+            model->UploadFrameData(Stream);
+            triangleStats_.submitted += model->GetVisibleTriangleCount();
+            triangleStats_.fullDetail += model->GetVisibleTriangleCount(true);
         }
-        glm::mat4 View = glm::translate(glm::vec3(0, 0, -5.0));
-        basePassShader->Set("uView", View);
-        // clear the color buffer
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        glEnable(GL_DEPTH_TEST);
-        glDepthFunc(GL_LESS);
-
-        for (const auto &model: models) {
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, BaseColor->getTextureID());
-            model->Draw();
+    }
+    Stream.unmap();
+
+    if (!drawMeshlets_) {
+        // Both base passes submit the same order, each with its own command set
+        ScopedZone zone(profiler_, "DrawSort");
+        buildDrawList(View);
+    }
+
+    // The scene targets only live during the frame, the HZB, the culling buffers and the
+    // backbuffer outlive it
+    FrameGraph.beginFrame();
+    auto sceneColor = FrameGraph.createTexture("SceneColor", {GL_RGBA16F, width_, height_});
+    auto sceneDepth = FrameGraph.createTexture("SceneDepth", {GL_DEPTH32F_STENCIL8, width_, height_});
+    auto hzb = FrameGraph.importTexture("HZB", HZBuffer.getTexture(),
+                                        {GL_R32F, HZBuffer.getWidth(), HZBuffer.getHeight()}, true);
+    auto drawCommands = FrameGraph.importBuffer("DrawCommands", true);
+    auto meshletIndices = FrameGraph.importBuffer("MeshletIndices", true);
+    auto backbuffer = FrameGraph.importBackbuffer(width_, height_);
+
+    // Select what was visible last frame and isn't hidden by last frame's HZB. Everything happens
+    // on the GPU, the results go straight into the indirect draw buffers of the models.
+    glm::vec3 viewOrigin = glm::vec3(glm::inverse(View)[3]);
+    if (Culling.isReady()) {
+        auto &cullingEarly = FrameGraph.addPass("CullingEarly", [this, viewProjection, viewOrigin]() {
+            for (size_t i = 0; i < models.size(); i++) {
+                Culling.cull(*models[i], *modelVisibility[i], OcclusionCulling::Phase::Early,
+                             viewProjection, viewOrigin, hzbValid_ ? &HZBuffer : nullptr,
+                             hzbViewProjection_, drawMeshlets_);
+            }
+        });
+        cullingEarly.read(drawCommands, RenderGraph::Access::StorageRead)
+                .write(drawCommands, RenderGraph::Access::StorageWrite);
+        if (hzbValid_) {
+            cullingEarly.read(hzb, RenderGraph::Access::Sampled);
+        }
+        if (drawMeshlets_) {
+            cullingEarly.write(meshletIndices, RenderGraph::Access::StorageWrite);
         }
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        basePassShader->deactivate();
     }
 
-    {
-        hzbPassShader->activate();
-        uint32_t Batch = 4;
-        uint32_t MipCount = 8;
-        uint32_t Width = 1024;
-        uint32_t Height = 512;
-        for (int i = 0; i < MipCount; i += Batch)
-        {
-            uint32_t currW = Width / (1 << i);
-            uint32_t currH = Height / (1 << i);
-            glActiveTexture(GL_TEXTURE0);
-            if (i == 0)
-            {
-                glBindTexture(GL_TEXTURE_2D, SceneDepthTexture);
+    // What the geometry passes draw with, the commands and the triangles the culling left
+    auto readGeometry = [this, drawCommands, meshletIndices](RenderGraph::Pass &pass) {
+        pass.read(drawCommands, RenderGraph::Access::IndirectRead);
+        if (drawMeshlets_) {
+            pass.read(meshletIndices, RenderGraph::Access::IndexRead);
+        }
+    };
+
+    if (depthPrepass) {
+        // Only depth first, the HZB and the late culling don't need color. The base pass shades
+        // once all depth is in.
+        auto &depthPrepass = FrameGraph.addPass("DepthPrepass", [this]() { drawDepth(0); });
+        depthPrepass.depthAttachment(sceneDepth, RenderGraph::LoadOp::Clear);
+        readGeometry(depthPrepass);
+    } else {
+        auto &basePass = FrameGraph.addPass("BasePass", [this]() {
+            if (!basePassShader) {
+                // still compiling, the targets are cleared all the same
+                return;
             }
-            else
-            {
-//                glBindTexture(GL_TEXTURE_2D, HZBuffer);
-//                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, i - 1);
-//                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, i - 1);
-                glBindImageTexture(4u, HZBuffer, i-1, false, 0, GL_READ_ONLY, GL_RGBA16F);
+            basePassShader->activate();
+            glState.setEnabled(GL_DEPTH_TEST, true);
+            glState.depthFunc(GL_LESS);
+            glState.depthMask(true);
+            // the meshlet cones already dropped most back faces, the rasterizer drops the rest
+            glState.setEnabled(GL_CULL_FACE, drawMeshlets_);
+            drawModels(0);
+            basePassShader->deactivate();
+        });
+        basePass.colorAttachment(sceneColor, RenderGraph::LoadOp::Clear)
+                .depthAttachment(sceneDepth, RenderGraph::LoadOp::Clear);
+        readGeometry(basePass);
+    }
+
+    if (HZBuffer.isReady()) {
+        FrameGraph.addPass("HZB", [this, sceneDepth, viewProjection]() {
+            HZBuffer.build(FrameGraph.getTexture(sceneDepth));
+            hzbValid_ = true;
+            hzbViewProjection_ = viewProjection;
+        })
+                .read(sceneDepth, RenderGraph::Access::Sampled)
+                .write(hzb, RenderGraph::Access::ImageStore);
+    }
+
+    // Test everything against the depth of the early pass and select what it missed
+    if (Culling.isReady()) {
+        auto &cullingLate = FrameGraph.addPass("CullingLate", [this, viewProjection, viewOrigin]() {
+            for (size_t i = 0; i < models.size(); i++) {
+                Culling.cull(*models[i], *modelVisibility[i], OcclusionCulling::Phase::Late,
+                             viewProjection, viewOrigin, hzbValid_ ? &HZBuffer : nullptr,
+                             viewProjection, drawMeshlets_);
             }
-            hzbPassShader->Set("isFirst", i == 0);
-            glBindImageTexture(0u, HZBuffer, i, false, 0, GL_WRITE_ONLY, GL_RGBA16F);
-            glBindImageTexture(1u, HZBuffer, i+1, false, 0, GL_WRITE_ONLY, GL_RGBA16F);
-            glBindImageTexture(2u, HZBuffer, i+2, false, 0, GL_WRITE_ONLY, GL_RGBA16F);
-            glBindImageTexture(3u, HZBuffer, i+3, false, 0, GL_WRITE_ONLY, GL_RGBA16F);
-            glMemoryBarrier(GL_ALL_BARRIER_BITS);
-            glDispatchCompute(currW / 8, currH / 8, 1);
+        });
+        cullingLate.read(drawCommands, RenderGraph::Access::StorageRead)
+                .write(drawCommands, RenderGraph::Access::StorageWrite);
+        if (HZBuffer.isReady()) {
+            cullingLate.read(hzb, RenderGraph::Access::Sampled);
+        }
+        if (drawMeshlets_) {
+            cullingLate.write(meshletIndices, RenderGraph::Access::StorageWrite);
         }
-        hzbPassShader->deactivate();
-        glBindTexture(GL_TEXTURE_2D, HZBuffer);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 9);
-        glBindTexture(GL_TEXTURE_2D, 0);
     }
 
-    {
-        // SceneTexture to backbuffer
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        finalPassShader->activate();
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        Quad.draw(SceneTexture);
-        finalPassShader->deactivate();
-        // Present the rendered image. This is an implicit glFlush.
-        auto swapResult = eglSwapBuffers(display_, surface_);
-        assert(swapResult == EGL_TRUE);
+    if (depthPrepass) {
+        if (Culling.isReady()) {
+            auto &depthPrepassLate = FrameGraph.addPass("DepthPrepassLate", [this]() { drawDepth(1); });
+            depthPrepassLate.depthAttachment(sceneDepth, RenderGraph::LoadOp::Load);
+            readGeometry(depthPrepassLate);
+        }
+
+        // Every pixel passes GL_EQUAL for the one surface left in front, nothing is shaded twice
+        auto &basePass = FrameGraph.addPass("BasePass", [this]() {
+            if (!basePassShader) {
+                return;
+            }
+            basePassShader->activate();
+            glState.depthFunc(GL_EQUAL);
+            glState.depthMask(false);
+            drawModels(0);
+            drawModels(1);
+            glState.depthMask(true);
+            basePassShader->deactivate();
+        });
+        basePass.colorAttachment(sceneColor, RenderGraph::LoadOp::Clear)
+                .depthAttachment(sceneDepth, RenderGraph::LoadOp::Load);
+        readGeometry(basePass);
+    } else if (Culling.isReady() && basePassShader) {
+        // Draw the newly revealed meshes on top of the early pass
+        auto &basePassLate = FrameGraph.addPass("BasePassLate", [this]() {
+            basePassShader->activate();
+            drawModels(1);
+            basePassShader->deactivate();
+        });
+        basePassLate.colorAttachment(sceneColor, RenderGraph::LoadOp::Load)
+                .depthAttachment(sceneDepth, RenderGraph::LoadOp::Load);
+        readGeometry(basePassLate);
+    }
+
+    // SceneColor to backbuffer. Without its program only the clear color is presented, the graph
+    // drops every pass of the scene then.
+    if (finalPassShader) {
+        FrameGraph.addPass("FinalPass", [this, sceneColor]() {
+            finalPassShader->activate();
+            Quad.draw(FrameGraph.getTexture(sceneColor));
+            finalPassShader->deactivate();
+        })
+                .read(sceneColor, RenderGraph::Access::Sampled)
+                .colorAttachment(backbuffer, RenderGraph::LoadOp::DontCare);
+    } else {
+        FrameGraph.addPass("FinalPass", []() {})
+                .colorAttachment(backbuffer, RenderGraph::LoadOp::Clear);
+    }
+
+    FrameGraph.execute(profiler_);
+    RenderTargets.endFrame();
+    Stream.endFrame();
+
+    // Present the rendered image. This is an implicit glFlush.
+    auto swapResult = eglSwapBuffers(display_, surface_);
+    assert(swapResult == EGL_TRUE);
+
+    glState.endFrame();
+    profiler_.endFrame();
+}
+
+bool Renderer::updatePrograms() {
+    if (programsReady_) {
+        return true;
+    }
+    shaderCompiler_.poll();
+
+    if (!basePassShader && !shaderCompiler_.isPending(basePassProgram_)) {
+        basePassShader = shaderCompiler_.take(basePassProgram_);
+        assert(basePassShader);
+        basePassShader->setUniformBlockBinding(CameraBuffer::kBlockName, CameraBuffer::kBinding);
+        basePassShader->setUniformBlockBinding(kModelBlockName, kModelBinding);
+    }
+
+    if (!depthPrepassShader && !shaderCompiler_.isPending(depthPrepassProgram_)) {
+        depthPrepassShader = shaderCompiler_.take(depthPrepassProgram_);
+        assert(depthPrepassShader);
+        depthPrepassShader->setUniformBlockBinding(CameraBuffer::kBlockName, CameraBuffer::kBinding);
+        depthPrepassShader->setUniformBlockBinding(kModelBlockName, kModelBinding);
+    }
+
+    if (!finalPassShader && !shaderCompiler_.isPending(finalPassProgram_)) {
+        finalPassShader = shaderCompiler_.take(finalPassProgram_);
+        assert(finalPassShader);
+    }
+
+    if (!HZBuffer.isReady() && !shaderCompiler_.isPending(hzbProgram_)) {
+        auto hzbPassShader = shaderCompiler_.take(hzbProgram_);
+        assert(hzbPassShader);
+        HZBuffer.setup(std::move(hzbPassShader), kReverseZ);
+    }
+
+    // both culling programs go in together, the meshlet one may be missing for good
+    if (!Culling.isReady() && !shaderCompiler_.isPending(cullProgram_)
+        && !shaderCompiler_.isPending(meshletProgram_)) {
+        auto cullPassShader = shaderCompiler_.take(cullProgram_);
+        assert(cullPassShader);
+        // needs more storage blocks than ES 3.1 guarantees, the meshes are still culled without it
+        auto meshletPassShader = shaderCompiler_.take(meshletProgram_);
+        if (!meshletPassShader) {
+            aout << "[ERROR] Meshlet culling shader unavailable, culling per mesh" << std::endl;
+        }
+        Culling.setup(std::move(cullPassShader), std::move(meshletPassShader));
+    }
+
+    if (!basePassShader || !depthPrepassShader || !finalPassShader || !HZBuffer.isReady()
+        || !Culling.isReady()) {
+        return false;
+    }
+
+    auto shaderEnd = std::chrono::steady_clock::now();
+    aout << "Shaders ready "
+         << std::chrono::duration<double, std::milli>(shaderEnd - shaderStart_).count()
+         << " ms after submission";
+    if (programCache_.isEnabled()) {
+        aout << ", program cache " << programCache_.getHits() << " hits, "
+             << programCache_.getMisses() << " misses";
+    }
+    aout << std::endl;
+
+    programsReady_ = true;
+    return true;
+}
+
+void Renderer::finishLoading() {
+    shaderCompiler_.finish();
+    updatePrograms();
+    assetLoader_.finish();
+}
+
+void Renderer::buildDrawList(const glm::mat4 &view) {
+    BasePassDraws.Clear();
+    // nothing to sort by while the program is still compiling
+    GLuint program = basePassShader ? basePassShader->getProgram() : 0;
+    GLuint material = BaseColor ? BaseColor->getTextureID() : 0;
+    for (uint32_t m = 0; m < models.size(); m++) {
+        if (modelConstants_[m] == kNoModelConstants) {
+            // the stream buffer was full, drawing it would read someone else's constants
+            continue;
+        }
+        const auto &model = *models[m];
+        const auto &bounds = model.GetWorldBounds();
+        for (uint32_t mesh: model.GetVisibleMeshes()) {
+            glm::vec4 center(bounds.centerX[mesh], bounds.centerY[mesh], bounds.centerZ[mesh], 1.f);
+            float depth = -(view * center).z;
+            float normalizedDepth = (depth - kPerspectiveNearPlane)
+                                    / (kPerspectiveFarPlane - kPerspectiveNearPlane);
+            BasePassDraws.Add(
+                    FDrawList::MakeKey(program, material, model.GetVertexArray(), normalizedDepth),
+                    m, mesh);
+        }
+    }
+    BasePassDraws.Sort();
+}
+
+void Renderer::drawModels(int commandSet, bool depthOnly) {
+    if (drawMeshlets_) {
+        if (!depthOnly) {
+            glState.bindTexture(0, GL_TEXTURE_2D, BaseColor ? BaseColor->getTextureID() : 0);
+        }
+        for (size_t m = 0; m < models.size(); m++) {
+            const auto &model = *models[m];
+            if (model.GetVisibleMeshes().empty() || model.GetMeshletCount() == 0
+                || modelConstants_[m] == kNoModelConstants) {
+                continue;
+            }
+            model.BindForDraw(depthOnly);
+            glBindBufferRange(GL_UNIFORM_BUFFER, kModelBinding, Stream.getBuffer(),
+                              modelConstants_[m], sizeof(ModelConstants));
+            model.DrawMeshlets(commandSet);
+        }
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        return;
+    }
+
+    uint32_t boundModel = ~0u;
+    for (const auto &draw: BasePassDraws.GetItems()) {
+        const auto &model = *models[draw.model];
+        if (!depthOnly) {
+            glState.bindTexture(0, GL_TEXTURE_2D, BaseColor ? BaseColor->getTextureID() : 0);
+        }
+        if (draw.model != boundModel) {
+            model.BindForDraw(depthOnly);
+            glBindBufferRange(GL_UNIFORM_BUFFER, kModelBinding, Stream.getBuffer(),
+                              modelConstants_[draw.model], sizeof(ModelConstants));
+            boundModel = draw.model;
+        }
+        model.DrawMesh(commandSet, draw.mesh);
+    }
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void Renderer::drawDepth(int commandSet) {
+    depthPrepassShader->activate();
+    glState.setEnabled(GL_DEPTH_TEST, true);
+    glState.depthFunc(GL_LESS);
+    glState.depthMask(true);
+    glState.setEnabled(GL_CULL_FACE, drawMeshlets_);
+    drawModels(commandSet, true);
+    depthPrepassShader->deactivate();
+}
+
+size_t Renderer::readMeshletTriangleCount() const {
+    size_t triangles = 0;
+    for (const auto &model: models) {
+        triangles += model->ReadMeshletTriangleCount();
+    }
+    return triangles;
+}
+
+void Renderer::pick(float x, float y) {
+    if (width_ <= 0 || height_ <= 0) {
+        return;
+    }
+    // pointer coordinates go down from the top left corner, NDC up from the bottom left one
+    glm::mat4 inverseViewProjection = glm::inverse(projectionMatrix_ * viewMatrix_);
+    glm::vec2 ndc(x / width_ * 2.f - 1.f, 1.f - y / height_ * 2.f);
+    glm::vec4 nearPoint = inverseViewProjection * glm::vec4(ndc, -1.f, 1.f);
+    glm::vec4 farPoint = inverseViewProjection * glm::vec4(ndc, 1.f, 1.f);
+    glm::vec3 origin = glm::vec3(nearPoint) / nearPoint.w;
+    glm::vec3 direction = glm::normalize(glm::vec3(farPoint) / farPoint.w - origin);
+
+    float distance = kPerspectiveFarPlane;
+    int hitModel = -1;
+    uint32_t hitInstance = 0;
+    uint32_t hitMesh = 0;
+    for (size_t m = 0; m < models.size(); m++) {
+        if (models[m]->Raycast(origin, direction, distance, hitInstance, hitMesh)) {
+            hitModel = int(m);
+        }
+    }
+    if (hitModel < 0) {
+        aout << " picked nothing";
+    } else {
+        aout << " picked model " << hitModel << " instance " << hitInstance << " mesh " << hitMesh
+             << " at " << distance;
     }
 }
 
-void Renderer::createHZB() {
-    glGenTextures(1, &HZBuffer);
-    glBindTexture(GL_TEXTURE_2D, HZBuffer);
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 9);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_R, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
-    glTexStorage2D(GL_TEXTURE_2D, 10, GL_RGBA16F, 1024, 512);
-    glGenerateMipmap(GL_TEXTURE_2D);
-    glBindTexture(GL_TEXTURE_2D, 0);
+bool Renderer::validateHZB() {
+    return HZB::validate(std::unique_ptr<Shader>(
+            Shader::loadShader(platform_->getAssets(), "Shaders/hzb.comp", &programCache_)));
 }
@@ -2,33 +2,46 @@
 #define ANDROIDGLINVESTIGATIONS_RENDERER_H
 
 #include <EGL/egl.h>
+#include <chrono>
 #include <memory>
 
+#include "AssetLoader.h"
+#include "CameraBuffer.h"
+#include "DrawList.h"
+#include "HZB.h"
 #include "Model.h"
+#include "OcclusionCulling.h"
+#include "Platform.h"
+#include "Profiler.h"
+#include "ProgramCache.h"
+#include "RenderGraph.h"
+#include "RenderTargetPool.h"
+#include "SceneGraph.h"
 #include "Shader.h"
-
-struct android_app;
+#include "ShaderCompiler.h"
+#include "StreamBuffer.h"
 
 class Renderer {
 public:
     /*!
-     * @param pApp the android_app this Renderer belongs to, needed to configure GL
+     * @param platform the platform this Renderer draws on, needed to configure GL and load assets
      */
-    inline Renderer(android_app *pApp) :
-            app_(pApp),
+    inline Renderer(std::unique_ptr<Platform> platform) :
+            platform_(std::move(platform)),
             display_(EGL_NO_DISPLAY),
             surface_(EGL_NO_SURFACE),
             context_(EGL_NO_CONTEXT),
             width_(0),
             height_(0),
-            shaderNeedsNewProjectionMatrix_(true) {
+            shaderNeedsNewProjectionMatrix_(true),
+            FrameGraph(RenderTargets) {
         initRenderer();
     }
 
     virtual ~Renderer();
 
     /*!
-     * Handles input from the android_app.
+     * Handles input from the platform.
      *
      * Note: this will clear the input queue
      */
@@ -39,6 +52,77 @@ public:
      */
     void render();
 
+    /*!
+     * @return the per-pass CPU/GPU timings of the frames rendered so far
+     */
+    const Profiler &getProfiler() const { return profiler_; }
+
+    /*!
+     * Triangles of the meshes that passed frustum culling in the last frame, at the LOD they were
+     * submitted with and at full detail
+     */
+    struct TriangleStats {
+        size_t submitted = 0;
+        size_t fullDetail = 0;
+    };
+
+    const TriangleStats &getTriangleStats() const { return triangleStats_; }
+
+    /*!
+     * Culls the meshlets of the meshes left by the occlusion culling on their own as well, against
+     * the frustum, their normal cone and the HZB, and draws the ones left with one draw per model
+     * and phase. On by default, off draws every visible Mesh whole.
+     */
+    void setMeshletCulling(bool enabled) { meshletCulling_ = enabled; }
+
+    /*!
+     * Renders depth alone with the positions first, then shades with GL_EQUAL and depth writes
+     * off, so every pixel is shaded once whatever the overdraw. Pays off with expensive fragment
+     * shaders on scenes with a lot of overdraw, off by default. The profiler times the passes
+     * apart: DepthPrepass, DepthPrepassLate and BasePass.
+     */
+    void setDepthPrepass(bool enabled) { depthPrepass_ = enabled; }
+
+    /*!
+     * Reads the meshlet draws back from the GPU, so only for stats after the frames are done
+     * @return triangles left after meshlet culling in the last frame, across both phases
+     */
+    size_t readMeshletTriangleCount() const;
+
+    /*!
+     * @return the buffer streaming the per-frame constants, to track its use
+     */
+    const StreamBuffer &getStream() const { return Stream; }
+
+    /*!
+     * @return the pool of the frame's render targets, to track their memory
+     */
+    const RenderTargetPool &getRenderTargets() const { return RenderTargets; }
+
+    /*!
+     * Waits for the programs compiling and the assets loading in the background, so the next
+     * frame draws the whole scene
+     */
+    void finishLoading();
+
+    /*!
+     * @return the transform hierarchy the model instances hang off, updated at the start of every
+     * frame
+     */
+    FSceneGraph &getScene() { return Scene; }
+
+    /*!
+     * Places every model once per scene node, following the node's world matrix, see
+     * FModel::SetInstances. Applies to the models still loading as well.
+     */
+    void setModelInstances(std::vector<uint32_t> nodes);
+
+    /*!
+     * Checks the GPU HZB builder against its CPU reference, see @a HZB::validate
+     * @return true if the pyramids match
+     */
+    bool validateHZB();
+
 private:
     /*!
      * Performs necessary OpenGL initialization. Customize this if you want to change your EGL
@@ -55,14 +139,55 @@ private:
     /*!
      * Creates the models for this sample. You'd likely load a scene configuration from a file or
      * use some other setup logic in your full game.
+     *
+     * The assets load in the background: models are drawn once they're uploaded, BaseColor is a
+     * placeholder until its texture is.
      */
     void createModels();
 
-    void createHZB();
+    /*!
+     * Runs the uploads of the assets loaded in the background, within a budget per frame
+     */
+    void updateAssets();
 
-    GLuint CreateTexture(int width, int height, uint internal_format, uint format, uint size);
+    /*!
+     * Updates the moved scene nodes and hands the new instance matrices to the models
+     */
+    void updateScene();
 
-    android_app *app_;
+    /*!
+     * Hands every program over to its pass as soon as it's compiled. render() leaves out the
+     * passes whose program is still missing, the others draw already.
+     * @return true once all of the programs are ready
+     */
+    bool updatePrograms();
+
+    /*!
+     * Fills BasePassDraws with the meshes that passed frustum culling, sorted by state and then
+     * front to back
+     */
+    void buildDrawList(const glm::mat4 &view);
+
+    /*!
+     * Submits BasePassDraws with one command set of the indirect buffers, binding only what
+     * changes between draws. See OcclusionCulling::Phase. With meshlet culling every model is a
+     * single draw of its compacted meshlets instead.
+     * @param depthOnly draws the position only vertex arrays, for drawDepth
+     */
+    void drawModels(int commandSet, bool depthOnly = false);
+
+    /*!
+     * Draws one command set with the depth prepass program, writing depth with GL_LESS
+     */
+    void drawDepth(int commandSet);
+
+    /*!
+     * Casts a ray through a pixel of the surface with the last frame's camera and logs the
+     * closest model, instance and Mesh it hits
+     */
+    void pick(float x, float y);
+
+    std::unique_ptr<Platform> platform_;
     EGLDisplay display_;
     EGLSurface surface_;
     EGLContext context_;
@@ -70,22 +195,91 @@ private:
     EGLint height_;
 
     bool shaderNeedsNewProjectionMatrix_;
+    glm::mat4 projectionMatrix_;
+    /*!
+     * The view the last frame was rendered with, for picking
+     */
+    glm::mat4 viewMatrix_ = glm::mat4(1.f);
+
+    Profiler profiler_;
+    TriangleStats triangleStats_;
+
+    /*!
+     * Binaries of the programs below, kept in the platform's cache directory across launches
+     */
+    ProgramCache programCache_;
+    ShaderCompiler shaderCompiler_;
+    ShaderCompiler::Handle basePassProgram_ = ShaderCompiler::kInvalidHandle;
+    ShaderCompiler::Handle depthPrepassProgram_ = ShaderCompiler::kInvalidHandle;
+    ShaderCompiler::Handle finalPassProgram_ = ShaderCompiler::kInvalidHandle;
+    ShaderCompiler::Handle hzbProgram_ = ShaderCompiler::kInvalidHandle;
+    ShaderCompiler::Handle cullProgram_ = ShaderCompiler::kInvalidHandle;
+    ShaderCompiler::Handle meshletProgram_ = ShaderCompiler::kInvalidHandle;
+    bool programsReady_ = false;
+    std::chrono::steady_clock::time_point shaderStart_;
+
+    /*!
+     * The per-frame constants of every pass
+     */
+    StreamBuffer Stream;
+    CameraBuffer Camera;
+    /*!
+     * Offset of the ModelConstants of models[i] in Stream, this frame. kNoModelConstants if they
+     * didn't fit, the model isn't drawn then.
+     */
+    static constexpr GLintptr kNoModelConstants = -1;
+    std::vector<GLintptr> modelConstants_;
 
     std::unique_ptr<Shader> basePassShader;
+    std::unique_ptr<Shader> depthPrepassShader;
     std::unique_ptr<Shader> finalPassShader;
-    std::unique_ptr<Shader> hzbPassShader;
     std::vector<Model> models_;
     std::vector<std::shared_ptr<FModel>> models;
+    FDrawList BasePassDraws;
+    /*!
+     * The visibility bits of models[i] at the end of the last frame
+     */
+    std::vector<std::unique_ptr<OcclusionCulling::Visibility>> modelVisibility;
 
     std::shared_ptr<TextureAsset> BaseColor;
+    FSceneGraph Scene;
+    /*!
+     * The scene nodes placing the instances of every model and their world matrices, both empty
+     * for the single instance a model starts with
+     */
+    std::vector<uint32_t> instanceNodes_;
+    std::vector<glm::mat4> modelInstances_;
+    bool instanceNodesChanged_ = false;
 
-    GLuint HZBuffer;
+    std::chrono::steady_clock::time_point assetStart_;
+    bool assetsResident_ = false;
 
-    GLuint SceneTexture;
-    GLuint SceneDepthTexture;
-    GLuint SceneFBO;
+    HZB HZBuffer;
+    /*!
+     * false until HZBuffer holds the depth of a frame rendered at the current size. The pyramid
+     * persists across frames: the early culling phase tests against the previous frame's HZB.
+     */
+    bool hzbValid_ = false;
+    glm::mat4 hzbViewProjection_;
+
+    OcclusionCulling Culling;
+    bool meshletCulling_ = true;
+    /*!
+     * Whether this frame culls and draws meshlets: meshletCulling_, once the culling programs are
+     * in and if meshlet.comp built
+     */
+    bool drawMeshlets_ = false;
+    bool depthPrepass_ = false;
+
+    RenderTargetPool RenderTargets;
+    RenderGraph FrameGraph;
 
     FQuad Quad;
+
+    /*!
+     * Last, so its workers are joined before anything their jobs might still reference goes away
+     */
+    AssetLoader assetLoader_;
 };
 
 #endif //ANDROIDGLINVESTIGATIONS_RENDERER_H
\ No newline at end of file
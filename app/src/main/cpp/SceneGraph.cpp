@@ -0,0 +1,91 @@
+#include "SceneGraph.h"
+
+#include "AndroidOut.h"
+#include "JobSystem.h"
+
+uint32_t FSceneGraph::AddNode(int32_t parent, const glm::vec3& translation, const glm::quat& rotation,
+                              const glm::vec3& scale)
+{
+    if (parent != kNoParent && (parent < 0 || size_t(parent) >= Size()))
+    {
+        aout << "[ERROR] Scene graph node parent " << parent << " doesn't exist" << std::endl;
+        parent = kNoParent;
+    }
+    auto node = static_cast<uint32_t>(Size());
+    mParents.push_back(parent);
+    mDepths.push_back(parent == kNoParent ? 0 : mDepths[parent] + 1);
+    mTranslations.push_back(translation);
+    mRotations.push_back(rotation);
+    mScales.push_back(scale);
+    mWorldMatrices.emplace_back(1.0f);
+    mDirty.push_back(0);
+    MarkDirty(node);
+    return node;
+}
+
+void FSceneGraph::Update()
+{
+    mLastUpdateCount = 0;
+    if (!mAnyDirty)
+    {
+        return;
+    }
+    mAnyDirty = false;
+
+    // a parent comes first, so its flag is final by the time its children look at it
+    for (auto& level : mLevels)
+    {
+        level.clear();
+    }
+    for (size_t node = 0; node < Size(); node++)
+    {
+        int32_t parent = mParents[node];
+        if (parent != kNoParent && mDirty[parent])
+        {
+            mDirty[node] = 1;
+        }
+        if (mDirty[node])
+        {
+            if (mDepths[node] >= mLevels.size())
+            {
+                mLevels.resize(mDepths[node] + 1);
+            }
+            mLevels[mDepths[node]].push_back(static_cast<uint32_t>(node));
+        }
+    }
+
+    // the nodes of one level only read the level above, which is complete
+    for (const auto& level : mLevels)
+    {
+        jobSystem.parallelFor(0, level.size(), kUpdateGrain, [this, &level](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; i++)
+            {
+                uint32_t node = level[i];
+                glm::mat4 local = glm::mat4_cast(mRotations[node]);
+                local[0] *= mScales[node].x;
+                local[1] *= mScales[node].y;
+                local[2] *= mScales[node].z;
+                local[3] = glm::vec4(mTranslations[node], 1.0f);
+                int32_t parent = mParents[node];
+                mWorldMatrices[node] = parent == kNoParent ? local : mWorldMatrices[parent] * local;
+                mDirty[node] = 0;
+            }
+        });
+        mLastUpdateCount += level.size();
+    }
+}
+
+void FSceneGraph::Clear()
+{
+    mParents.clear();
+    mDepths.clear();
+    mTranslations.clear();
+    mRotations.clear();
+    mScales.clear();
+    mWorldMatrices.clear();
+    mDirty.clear();
+    mLevels.clear();
+    mAnyDirty = false;
+    mLastUpdateCount = 0;
+}
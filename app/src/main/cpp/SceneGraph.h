@@ -0,0 +1,105 @@
+#ifndef ANDROIDGLINVESTIGATIONS_SCENEGRAPH_H
+#define ANDROIDGLINVESTIGATIONS_SCENEGRAPH_H
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+/*!
+ * A transform hierarchy stored as structure of arrays. Nodes are only ever appended and a parent
+ * always comes before its children, so one pass in index order sees every parent before its
+ * children.
+ *
+ * Changing a local transform marks the node dirty. Update() recomputes the world matrices of the
+ * dirty nodes and everything below them, one depth level after the other, with each level split
+ * into chunks across the job system. When nothing changed it returns immediately, so a static
+ * scene costs nothing per frame.
+ */
+class FSceneGraph
+{
+public:
+    static constexpr int32_t kNoParent = -1;
+
+    /*!
+     * Nodes of one level one job recomputes
+     */
+    static constexpr size_t kUpdateGrain = 1024;
+
+    /*!
+     * Appends a node, dirty until the next Update()
+     * @param parent an existing node, or kNoParent for a root
+     * @return the index of the node
+     */
+    uint32_t AddNode(int32_t parent,
+                     const glm::vec3& translation = glm::vec3(0.0f),
+                     const glm::quat& rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f),
+                     const glm::vec3& scale = glm::vec3(1.0f));
+
+    void SetTranslation(uint32_t node, const glm::vec3& translation)
+    {
+        mTranslations[node] = translation;
+        MarkDirty(node);
+    }
+
+    void SetRotation(uint32_t node, const glm::quat& rotation)
+    {
+        mRotations[node] = rotation;
+        MarkDirty(node);
+    }
+
+    void SetScale(uint32_t node, const glm::vec3& scale)
+    {
+        mScales[node] = scale;
+        MarkDirty(node);
+    }
+
+    const glm::vec3& GetTranslation(uint32_t node) const { return mTranslations[node]; }
+
+    const glm::quat& GetRotation(uint32_t node) const { return mRotations[node]; }
+
+    const glm::vec3& GetScale(uint32_t node) const { return mScales[node]; }
+
+    int32_t GetParent(uint32_t node) const { return mParents[node]; }
+
+    /*!
+     * @return the world matrix of @a node as of the last Update()
+     */
+    const glm::mat4& GetWorldMatrix(uint32_t node) const { return mWorldMatrices[node]; }
+
+    /*!
+     * Recomputes the world matrices of the dirty subtrees
+     */
+    void Update();
+
+    /*!
+     * @return how many world matrices the last Update() recomputed, 0 if nothing moved
+     */
+    size_t GetLastUpdateCount() const { return mLastUpdateCount; }
+
+    size_t Size() const { return mParents.size(); }
+
+    void Clear();
+
+private:
+    void MarkDirty(uint32_t node)
+    {
+        mDirty[node] = 1;
+        mAnyDirty = true;
+    }
+
+    std::vector<int32_t> mParents;
+    std::vector<uint32_t> mDepths;
+    std::vector<glm::vec3> mTranslations;
+    std::vector<glm::quat> mRotations;
+    std::vector<glm::vec3> mScales;
+    std::vector<glm::mat4> mWorldMatrices;
+    // bytes rather than vector<bool>, the update jobs clear neighbouring flags concurrently
+    std::vector<uint8_t> mDirty;
+    // the dirty nodes of each depth, reused between updates
+    std::vector<std::vector<uint32_t>> mLevels;
+    bool mAnyDirty = false;
+    size_t mLastUpdateCount = 0;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_SCENEGRAPH_H
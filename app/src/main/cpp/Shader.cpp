@@ -1,184 +1,257 @@
 #include "Shader.h"
 
+#include <algorithm>
+
 #include "AndroidOut.h"
 #include "Model.h"
 #include "Utility.h"
 
-Shader* Shader::loadShader(AAssetManager *assetManager, const std::string &vertexPath, const std::string &fragmentPath)
-{
-    auto vertexAsset = AAssetManager_open(
-            assetManager,
-            vertexPath.c_str(),
-            AASSET_MODE_BUFFER);
-    const void *pVertexBuffer = AAsset_getBuffer(vertexAsset);
-    size_t vertexLength = AAsset_getLength(vertexAsset);
-    std::string vertexSource((char*)pVertexBuffer, vertexLength);
-
-    auto fragmentAsset = AAssetManager_open(
-            assetManager,
-            fragmentPath.c_str(),
-            AASSET_MODE_BUFFER);
-    const void *pFragmentBuffer = AAsset_getBuffer(fragmentAsset);
-    size_t FragmentLength = AAsset_getLength(fragmentAsset);
-    std::string fragmentSource((char*)pFragmentBuffer, FragmentLength);
-    return loadShader(vertexSource, fragmentSource);
-}
-
-Shader* Shader::loadShader(AAssetManager *assetManager, const std::string &computePath)
+Shader* Shader::loadShader(AssetProvider &assets, const std::string &vertexPath, const std::string &fragmentPath, ProgramCache *cache)
 {
-    auto asset = AAssetManager_open(
-            assetManager,
-            computePath.c_str(),
-            AASSET_MODE_BUFFER);
-    const void *pBuffer = AAsset_getBuffer(asset);
-    size_t Length = AAsset_getLength(asset);
-    std::string Source((char*)pBuffer, Length);
-
-    return loadShader(Source);
+    std::string vertexSource = assets.readText(vertexPath);
+    std::string fragmentSource = assets.readText(fragmentPath);
+    if (vertexSource.empty() || fragmentSource.empty()) {
+        return nullptr;
+    }
+    return loadShader(vertexSource, fragmentSource, cache);
 }
 
-Shader* Shader::loadShader(const std::string& computeSource)
+Shader* Shader::loadShader(AssetProvider &assets, const std::string &computePath, ProgramCache *cache)
 {
-    Shader *shader = nullptr;
-
-    GLuint computeShader = loadShader(GL_COMPUTE_SHADER, computeSource);
-    if (!computeShader) {
+    std::string Source = assets.readText(computePath);
+    if (Source.empty()) {
         return nullptr;
     }
 
-    GLuint program = glCreateProgram();
-    if (program) {
-        glAttachShader(program, computeShader);
-
-        glLinkProgram(program);
-        GLint linkStatus = GL_FALSE;
-        glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
-        if (linkStatus != GL_TRUE) {
-            GLint logLength = 0;
-            glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLength);
-
-            // If we fail to link the shader program, log the result for debugging
-            if (logLength) {
-                GLchar *log = new GLchar[logLength];
-                glGetProgramInfoLog(program, logLength, nullptr, log);
-                aout << "Failed to link program with:\n" << log << std::endl;
-                delete[] log;
-            }
-
-            glDeleteProgram(program);
-        }
-        else
-        {
-            shader = new Shader(program);
-        }
-    }
-    glDeleteShader(computeShader);
+    return loadShader(Source, cache);
+}
 
-    return shader;
+Shader* Shader::loadShader(const std::string& computeSource, ProgramCache *cache)
+{
+    return loadProgram({GL_COMPUTE_SHADER}, {computeSource}, cache);
 }
+
 Shader *Shader::loadShader(
         const std::string &vertexSource,
-        const std::string &fragmentSource) {
-    Shader *shader = nullptr;
-
-    GLuint vertexShader = loadShader(GL_VERTEX_SHADER, vertexSource);
-    if (!vertexShader) {
-        return nullptr;
-    }
-
-    GLuint fragmentShader = loadShader(GL_FRAGMENT_SHADER, fragmentSource);
-    if (!fragmentShader) {
-        glDeleteShader(vertexShader);
-        return nullptr;
-    }
-
-    GLuint program = glCreateProgram();
-    if (program) {
-        glAttachShader(program, vertexShader);
-        glAttachShader(program, fragmentShader);
-
-        glLinkProgram(program);
-        GLint linkStatus = GL_FALSE;
-        glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
-        if (linkStatus != GL_TRUE) {
-            GLint logLength = 0;
-            glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLength);
-
-            // If we fail to link the shader program, log the result for debugging
-            if (logLength) {
-                GLchar *log = new GLchar[logLength];
-                glGetProgramInfoLog(program, logLength, nullptr, log);
-                aout << "Failed to link program with:\n" << log << std::endl;
-                delete[] log;
-            }
+        const std::string &fragmentSource,
+        ProgramCache *cache) {
+    return loadProgram({GL_VERTEX_SHADER, GL_FRAGMENT_SHADER}, {vertexSource, fragmentSource},
+                       cache);
+}
 
-            glDeleteProgram(program);
-        } else {
-            // Get the attribute and uniform locations by name. You may also choose to hardcode
-            // indices with layout= in your shader, but it is not done in this sample
-//            GLint positionAttribute = glGetAttribLocation(program, positionAttributeName.c_str());
-//            GLint uvAttribute = glGetAttribLocation(program, uvAttributeName.c_str());
-//            GLint projectionMatrixUniform = glGetUniformLocation(
-//                    program,
-//                    projectionMatrixUniformName.c_str());
-//            GLint viewMatrixUniform = glGetUniformLocation(
-//                    program,
-//                    viewMatrixUniformName.c_str());
-            // Only create a new shader if all the attributes are found.
-            shader = new Shader(program);
-//            if (positionAttribute != -1
-//                && uvAttribute != -1
-//                && projectionMatrixUniform != -1) {
-//
-//
-//            } else {
-//                glDeleteProgram(program);
-//            }
+Shader *Shader::loadProgram(const std::vector<GLenum> &types,
+                            const std::vector<std::string> &sources, ProgramCache *cache) {
+    if (cache) {
+        if (GLuint program = cache->load(sources)) {
+            return new Shader(program);
         }
     }
 
-    // The shaders are no longer needed once the program is linked. Release their memory.
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
-
-    return shader;
+    GLuint program = beginProgram(types, sources, cache != nullptr);
+    return program ? finishProgram(program, sources, cache) : nullptr;
 }
 
-GLuint Shader::loadShader(GLenum shaderType, const std::string &shaderSource) {
+GLuint Shader::beginProgram(const std::vector<GLenum> &types,
+                            const std::vector<std::string> &sources, bool retrievable) {
     Utility::assertGlError();
-    GLuint shader = glCreateShader(shaderType);
-    if (shader) {
-        auto *shaderRawString = (GLchar *) shaderSource.c_str();
-        GLint shaderLength = shaderSource.length();
+    GLuint program = glCreateProgram();
+    if (!program) {
+        return 0;
+    }
+
+    for (size_t i = 0; i < types.size(); i++) {
+        GLuint shader = glCreateShader(types[i]);
+        if (!shader) {
+            glState.deleteProgram(program);
+            return 0;
+        }
+        auto *shaderRawString = (GLchar *) sources[i].c_str();
+        GLint shaderLength = sources[i].length();
         glShaderSource(shader, 1, &shaderRawString, &shaderLength);
         glCompileShader(shader);
+        glAttachShader(program, shader);
+        // Only flagged for deletion, the shader lives as long as it's attached so its compile log
+        // can still be read in finishProgram
+        glDeleteShader(shader);
+    }
+    if (retrievable) {
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+    glLinkProgram(program);
+    return program;
+}
 
-        GLint shaderCompiled = 0;
-        glGetShaderiv(shader, GL_COMPILE_STATUS, &shaderCompiled);
-
-        // If the shader doesn't compile, log the result to the terminal for debugging
-        if (!shaderCompiled) {
+Shader *Shader::finishProgram(GLuint program, const std::vector<std::string> &sources,
+                              ProgramCache *cache) {
+    GLint linkStatus = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
+    if (linkStatus != GL_TRUE) {
+        // If a stage doesn't compile, log the result to the terminal for debugging
+        GLuint shaders[3];
+        GLsizei shaderCount = 0;
+        glGetAttachedShaders(program, 3, &shaderCount, shaders);
+        for (GLsizei i = 0; i < shaderCount; i++) {
+            GLint shaderCompiled = 0;
+            glGetShaderiv(shaders[i], GL_COMPILE_STATUS, &shaderCompiled);
             GLint infoLength = 0;
-            glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &infoLength);
-
-            if (infoLength) {
+            glGetShaderiv(shaders[i], GL_INFO_LOG_LENGTH, &infoLength);
+            if (!shaderCompiled && infoLength) {
                 auto *infoLog = new GLchar[infoLength];
-                glGetShaderInfoLog(shader, infoLength, nullptr, infoLog);
+                glGetShaderInfoLog(shaders[i], infoLength, nullptr, infoLog);
                 aout << "Failed to compile with:\n" << infoLog << std::endl;
                 delete[] infoLog;
             }
+        }
+
+        GLint logLength = 0;
+        glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLength);
 
-            glDeleteShader(shader);
-            shader = 0;
+        // If we fail to link the shader program, log the result for debugging
+        if (logLength) {
+            GLchar *log = new GLchar[logLength];
+            glGetProgramInfoLog(program, logLength, nullptr, log);
+            aout << "Failed to link program with:\n" << log << std::endl;
+            delete[] log;
         }
+
+        glState.deleteProgram(program);
+        return nullptr;
     }
-    return shader;
+
+    if (cache) {
+        cache->store(sources, program);
+    }
+    return new Shader(program);
 }
 
 void Shader::activate() const {
-    glUseProgram(program_);
+    glState.useProgram(program_);
 }
 
 void Shader::deactivate() const {
-    glUseProgram(0);
+}
+
+bool UniformType<int>::matches(GLenum type) {
+    return type == GL_INT || Shader::isOpaqueType(type);
+}
+
+Shader::Shader(GLuint program) : program_(program) {
+    reflect();
+}
+
+void Shader::reflect() {
+    GLint maxNameLength = 0;
+    for (GLenum interface: {GL_UNIFORM, GL_UNIFORM_BLOCK, GL_SHADER_STORAGE_BLOCK}) {
+        GLint length = 0;
+        glGetProgramInterfaceiv(program_, interface, GL_MAX_NAME_LENGTH, &length);
+        maxNameLength = std::max(maxNameLength, length);
+    }
+    std::vector<GLchar> name(std::max(maxNameLength, 1));
+    auto resourceName = [&](GLenum interface, GLuint index) {
+        glGetProgramResourceName(program_, interface, index, name.size(), nullptr, name.data());
+        std::string result(name.data());
+        // arrays are reported as their first element
+        if (result.size() > 3 && result.compare(result.size() - 3, 3, "[0]") == 0) {
+            result.resize(result.size() - 3);
+        }
+        return result;
+    };
+
+    GLint uniformCount = 0;
+    glGetProgramInterfaceiv(program_, GL_UNIFORM, GL_ACTIVE_RESOURCES, &uniformCount);
+    for (GLint i = 0; i < uniformCount; i++) {
+        const GLenum properties[] = {GL_TYPE, GL_ARRAY_SIZE, GL_LOCATION, GL_BLOCK_INDEX};
+        GLint values[4];
+        glGetProgramResourceiv(program_, GL_UNIFORM, i, 4, properties, 4, nullptr, values);
+        if (values[3] != -1) {
+            // a block member, it lives in the block's buffer
+            continue;
+        }
+        Uniform uniform{resourceName(GL_UNIFORM, i), values[2], GLenum(values[0]), values[1], -1};
+        if (isOpaqueType(uniform.type)) {
+            glGetUniformiv(program_, uniform.location, &uniform.unit);
+        }
+        uniforms_.push_back(std::move(uniform));
+    }
+
+    for (GLenum interface: {GL_UNIFORM_BLOCK, GL_SHADER_STORAGE_BLOCK}) {
+        GLint blockCount = 0;
+        glGetProgramInterfaceiv(program_, interface, GL_ACTIVE_RESOURCES, &blockCount);
+        for (GLint i = 0; i < blockCount; i++) {
+            const GLenum properties[] = {GL_BUFFER_BINDING, GL_BUFFER_DATA_SIZE};
+            GLint values[2];
+            glGetProgramResourceiv(program_, interface, i, 2, properties, 2, nullptr, values);
+            blocks_.push_back({resourceName(interface, i), GLuint(i), values[0], values[1],
+                               interface == GL_SHADER_STORAGE_BLOCK});
+        }
+    }
+
+    auto byName = [](const auto &a, const auto &b) { return a.name < b.name; };
+    std::sort(uniforms_.begin(), uniforms_.end(), byName);
+    std::sort(blocks_.begin(), blocks_.end(), byName);
+}
+
+const Shader::Uniform *Shader::findUniform(const std::string &name) const {
+    auto it = std::lower_bound(uniforms_.begin(), uniforms_.end(), name,
+                               [](const Uniform &uniform, const std::string &name) {
+                                   return uniform.name < name;
+                               });
+    return it != uniforms_.end() && it->name == name ? &*it : nullptr;
+}
+
+const Shader::Block *Shader::findBlock(const std::string &name) const {
+    auto it = std::lower_bound(blocks_.begin(), blocks_.end(), name,
+                               [](const Block &block, const std::string &name) {
+                                   return block.name < name;
+                               });
+    return it != blocks_.end() && it->name == name ? &*it : nullptr;
+}
+
+bool Shader::setUniformBlockBinding(const std::string &name, GLuint binding) {
+    auto it = std::find_if(blocks_.begin(), blocks_.end(), [&name](const Block &block) {
+        return block.name == name && !block.storage;
+    });
+    if (it == blocks_.end()) {
+        aout << "[ERROR] Uniform block \"" << name << "\" isn't active" << std::endl;
+        return false;
+    }
+    glUniformBlockBinding(program_, it->index, binding);
+    it->binding = static_cast<GLint>(binding);
+    return true;
+}
+
+bool Shader::isOpaqueType(GLenum type) {
+    switch (type) {
+        case GL_SAMPLER_2D:
+        case GL_SAMPLER_3D:
+        case GL_SAMPLER_CUBE:
+        case GL_SAMPLER_2D_SHADOW:
+        case GL_SAMPLER_2D_ARRAY:
+        case GL_SAMPLER_2D_ARRAY_SHADOW:
+        case GL_SAMPLER_CUBE_SHADOW:
+        case GL_SAMPLER_2D_MULTISAMPLE:
+        case GL_INT_SAMPLER_2D:
+        case GL_INT_SAMPLER_3D:
+        case GL_INT_SAMPLER_CUBE:
+        case GL_INT_SAMPLER_2D_ARRAY:
+        case GL_UNSIGNED_INT_SAMPLER_2D:
+        case GL_UNSIGNED_INT_SAMPLER_3D:
+        case GL_UNSIGNED_INT_SAMPLER_CUBE:
+        case GL_UNSIGNED_INT_SAMPLER_2D_ARRAY:
+        case GL_IMAGE_2D:
+        case GL_IMAGE_3D:
+        case GL_IMAGE_CUBE:
+        case GL_IMAGE_2D_ARRAY:
+        case GL_INT_IMAGE_2D:
+        case GL_INT_IMAGE_3D:
+        case GL_INT_IMAGE_CUBE:
+        case GL_INT_IMAGE_2D_ARRAY:
+        case GL_UNSIGNED_INT_IMAGE_2D:
+        case GL_UNSIGNED_INT_IMAGE_3D:
+        case GL_UNSIGNED_INT_IMAGE_CUBE:
+        case GL_UNSIGNED_INT_IMAGE_2D_ARRAY:
+            return true;
+        default:
+            return false;
+    }
 }
@@ -2,13 +2,66 @@
 #define ANDROIDGLINVESTIGATIONS_SHADER_H
 
 #include <string>
-#include <android/asset_manager.h>
+#include <vector>
 #include <GLES3/gl31.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include "AndroidOut.h"
+#include "GLStateCache.h"
+#include "Platform.h"
+#include "ProgramCache.h"
 
 class Model;
+class ShaderCompiler;
+
+/*!
+ * The location of a uniform of type T, resolved by Shader::getUniform. Invalid handles have
+ * location -1, which GL ignores.
+ */
+template<typename T>
+class UniformHandle {
+public:
+    bool isValid() const { return location_ != -1; }
+
+private:
+    friend class Shader;
+
+    GLint location_ = -1;
+};
+
+/*!
+ * Which GL uniform types a UniformHandle<T> may refer to
+ */
+template<typename T>
+struct UniformType;
+
+template<>
+struct UniformType<glm::mat4> {
+    static bool matches(GLenum type) { return type == GL_FLOAT_MAT4; }
+};
+
+template<>
+struct UniformType<bool> {
+    static bool matches(GLenum type) { return type == GL_BOOL; }
+};
+
+template<>
+struct UniformType<int> {
+    /*!
+     * Samplers and images are set as int too
+     */
+    static bool matches(GLenum type);
+};
+
+template<>
+struct UniformType<glm::vec3> {
+    static bool matches(GLenum type) { return type == GL_FLOAT_VEC3; }
+};
+
+template<>
+struct UniformType<glm::ivec2> {
+    static bool matches(GLenum type) { return type == GL_INT_VEC2; }
+};
 
 /*!
  * A class representing a simple shader program. It consists of vertex and fragment components. The
@@ -19,43 +72,139 @@ class Model;
  */
 class Shader {
 public:
-    static Shader* loadShader(AAssetManager *assetManager, const std::string &vertexPath, const std::string &fragmentPath);
+    /*!
+     * The loaders take an optional ProgramCache: a cached binary is used instead of compiling, and
+     * programs compiled from source are added to it. They block until the driver has compiled and
+     * linked the program, use ShaderCompiler to compile without stalling.
+     */
+    static Shader* loadShader(AssetProvider &assets, const std::string &vertexPath, const std::string &fragmentPath, ProgramCache *cache = nullptr);
 
-    static Shader* loadShader(AAssetManager *assetManager, const std::string &computePath);
+    static Shader* loadShader(AssetProvider &assets, const std::string &computePath, ProgramCache *cache = nullptr);
 
-    static Shader *loadShader(const std::string &vertexSource, const std::string &fragmentSource);
+    static Shader *loadShader(const std::string &vertexSource, const std::string &fragmentSource, ProgramCache *cache = nullptr);
 
-    static Shader * loadShader(const std::string& computeSource);
+    static Shader * loadShader(const std::string& computeSource, ProgramCache *cache = nullptr);
 
     inline ~Shader() {
         if (program_) {
-            glDeleteProgram(program_);
+            glState.deleteProgram(program_);
             program_ = 0;
         }
     }
 
-    void Set(const std::string& name, glm::mat4& mat) const
-    {
-        int location = glGetUniformLocation(program_, name.c_str());
-        if (location == -1)
-            aout << "[ERROR]SetMatrix(\"" << name << "\") Failed" << std::endl;
-        glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(mat));
+    /*!
+     * An active uniform of the linked program
+     */
+    struct Uniform {
+        std::string name;
+        GLint location;
+        GLenum type;
+        GLint arraySize;
+        /*!
+         * The texture or image unit of samplers and images, -1 for everything else
+         */
+        GLint unit;
+    };
+
+    /*!
+     * An active uniform or shader storage block of the linked program
+     */
+    struct Block {
+        std::string name;
+        GLuint index;
+        GLint binding;
+        GLint dataSize;
+        bool storage;
+    };
+
+    /*!
+     * Resolves a uniform once, checking its type against T. Keep the handle and set through it
+     * instead of by name on hot paths.
+     * @return the handle, invalid (and setting it a no-op) if there's no such uniform of type T
+     */
+    template<typename T>
+    UniformHandle<T> getUniform(const std::string &name) const {
+        UniformHandle<T> handle;
+        const Uniform *uniform = findUniform(name);
+        if (!uniform) {
+            aout << "[ERROR] Uniform \"" << name << "\" isn't active" << std::endl;
+        } else if (!UniformType<T>::matches(uniform->type)) {
+            aout << "[ERROR] Uniform \"" << name << "\" has GL type " << uniform->type
+                 << ", which doesn't match the handle" << std::endl;
+        } else {
+            handle.location_ = uniform->location;
+        }
+        return handle;
+    }
+
+    void Set(UniformHandle<glm::mat4> handle, const glm::mat4 &mat) const {
+        glUniformMatrix4fv(handle.location_, 1, GL_FALSE, glm::value_ptr(mat));
+    }
+
+    void Set(UniformHandle<bool> handle, bool value) const {
+        glUniform1i(handle.location_, (int) value);
+    }
+
+    void Set(UniformHandle<int> handle, int value) const {
+        glUniform1i(handle.location_, value);
+    }
+
+    void Set(UniformHandle<glm::vec3> handle, const glm::vec3 &value) const {
+        glUniform3f(handle.location_, value.x, value.y, value.z);
+    }
+
+    void Set(UniformHandle<glm::ivec2> handle, const glm::ivec2 &value) const {
+        glUniform2i(handle.location_, value.x, value.y);
     }
 
-    void Set(const std::string& name, bool value) const
-    {
-        int location = glGetUniformLocation(program_, name.c_str());
-        if (location == -1)
-            aout << "[ERROR]Set bool(\"" << name << "\") Failed" << std::endl;
-        glUniform1i(location, (int)value);
+    /*!
+     * Sets a uniform by name, resolved through the reflected table. Fine for setup code, use a
+     * UniformHandle for anything set every frame.
+     */
+    template<typename T>
+    void Set(const std::string &name, const T &value) const {
+        Set(getUniform<T>(name), value);
     }
+
+    /*!
+     * @return the reflected uniform, nullptr if it isn't active. Arrays are named without [0].
+     */
+    const Uniform *findUniform(const std::string &name) const;
+
+    /*!
+     * @return the reflected uniform or storage block, nullptr if it isn't active
+     */
+    const Block *findBlock(const std::string &name) const;
+
+    /*!
+     * Binds a uniform block to a uniform buffer binding point
+     * @return false if there is no such uniform block
+     */
+    bool setUniformBlockBinding(const std::string &name, GLuint binding);
+
+    /*!
+     * @return every active uniform outside blocks, sorted by name
+     */
+    const std::vector<Uniform> &getUniforms() const { return uniforms_; }
+
+    /*!
+     * @return every active uniform and storage block, sorted by name
+     */
+    const std::vector<Block> &getBlocks() const { return blocks_; }
+
+    /*!
+     * @return the GL name of the program, e.g. to sort draws by it
+     */
+    GLuint getProgram() const { return program_; }
+
     /*!
      * Prepares the shader for use, call this before executing any draw commands
      */
     void activate() const;
 
     /*!
-     * Cleans up the shader after use, call this after executing any draw commands
+     * Marks the end of the shader's use. The program stays bound: unbinding it would only cost a
+     * call, and rebinding the same program next frame is skipped by the state cache.
      */
     void deactivate() const;
 
@@ -74,24 +223,52 @@ public:
 //    void setViewMatrix(float* InViewMatrix) const;
 private:
     /*!
-     * Helper function to load a shader of a given type
-     * @param shaderType The OpenGL shader type. Should either be GL_VERTEX_SHADER or GL_FRAGMENT_SHADER
-     * @param shaderSource The full source of the shader
-     * @return the id of the shader, as returned by glCreateShader, or 0 in the case of an error
+     * Starts compiling and linking a program. Doesn't query any status, so the driver is free to
+     * do the work in the background.
+     * @param types the stage of each source, e.g. GL_VERTEX_SHADER
+     * @param sources the full source of each stage
+     * @param retrievable set GL_PROGRAM_BINARY_RETRIEVABLE_HINT, for programs going into a cache
+     * @return the program, or 0 if GL couldn't create the objects
      */
-    static GLuint loadShader(GLenum shaderType, const std::string &shaderSource);
+    static GLuint beginProgram(const std::vector<GLenum> &types,
+                               const std::vector<std::string> &sources, bool retrievable);
 
     /*!
-     * Constructs a new instance of a shader. Use @a loadShader
-     * @param program the GL program id of the shader
-     * @param position the attribute location of the position
-     * @param uv the attribute location of the uv coordinates
-     * @param projectionMatrix the uniform location of the projection matrix
+     * Waits for a program from @a beginProgram and wraps it, logging the compile and link errors
+     * if it failed. The program is stored in @a cache on success and deleted on failure.
+     * @return the shader, nullptr if the program didn't link
      */
-    constexpr Shader(GLuint program)
-            : program_(program) {}
+    static Shader *finishProgram(GLuint program, const std::vector<std::string> &sources,
+                                 ProgramCache *cache);
+
+    /*!
+     * Compiles and links synchronously, unless @a cache has the program
+     */
+    static Shader *loadProgram(const std::vector<GLenum> &types,
+                               const std::vector<std::string> &sources, ProgramCache *cache);
+
+    /*!
+     * Constructs a new instance of a shader and reflects its interface. Use @a loadShader
+     * @param program the GL program id of the shader, linked successfully
+     */
+    Shader(GLuint program);
+
+    /*!
+     * Fills the uniform and block tables from the linked program
+     */
+    void reflect();
+
+    /*!
+     * @return true for sampler and image types, whose value is a unit
+     */
+    static bool isOpaqueType(GLenum type);
+
+    friend struct UniformType<int>;
+    friend class ShaderCompiler;
 
     GLuint program_;
+    std::vector<Uniform> uniforms_;
+    std::vector<Block> blocks_;
 
 };
 
@@ -0,0 +1,112 @@
+#include "ShaderCompiler.h"
+
+#include <EGL/egl.h>
+
+#include "AndroidOut.h"
+#include "Utility.h"
+
+void ShaderCompiler::init(ProgramCache *cache) {
+    cache_ = cache;
+    if (Utility::hasGlExtension("GL_KHR_parallel_shader_compile")) {
+        glMaxShaderCompilerThreadsKHR_ = reinterpret_cast<PFNGLMAXSHADERCOMPILERTHREADSKHRPROC>(
+                eglGetProcAddress("glMaxShaderCompilerThreadsKHR"));
+    }
+    if (glMaxShaderCompilerThreadsKHR_) {
+        // 0xFFFFFFFF leaves the number of threads to the driver
+        glMaxShaderCompilerThreadsKHR_(0xFFFFFFFF);
+    }
+    aout << "Parallel shader compilation " << (isParallel() ? "enabled" : "unavailable")
+         << std::endl;
+}
+
+ShaderCompiler::Handle ShaderCompiler::submit(const std::string &vertexSource,
+                                              const std::string &fragmentSource) {
+    return submitProgram({GL_VERTEX_SHADER, GL_FRAGMENT_SHADER}, {vertexSource, fragmentSource});
+}
+
+ShaderCompiler::Handle ShaderCompiler::submit(const std::string &computeSource) {
+    return submitProgram({GL_COMPUTE_SHADER}, {computeSource});
+}
+
+ShaderCompiler::Handle ShaderCompiler::submit(AssetProvider &assets, const std::string &vertexPath,
+                                              const std::string &fragmentPath) {
+    std::string vertexSource = assets.readText(vertexPath);
+    std::string fragmentSource = assets.readText(fragmentPath);
+    if (vertexSource.empty() || fragmentSource.empty()) {
+        return kInvalidHandle;
+    }
+    return submit(vertexSource, fragmentSource);
+}
+
+ShaderCompiler::Handle ShaderCompiler::submit(AssetProvider &assets,
+                                              const std::string &computePath) {
+    std::string source = assets.readText(computePath);
+    if (source.empty()) {
+        return kInvalidHandle;
+    }
+    return submit(source);
+}
+
+ShaderCompiler::Handle ShaderCompiler::submitProgram(const std::vector<GLenum> &types,
+                                                     std::vector<std::string> sources) {
+    Job job;
+    if (cache_) {
+        if (GLuint program = cache_->load(sources)) {
+            job.shader.reset(new Shader(program));
+        }
+    }
+    if (!job.shader) {
+        job.program = Shader::beginProgram(types, sources, cache_ != nullptr);
+        job.pending = job.program != 0;
+        pendingCount_ += job.pending;
+        // the sources are only needed again to key the cache
+        if (cache_) {
+            job.sources = std::move(sources);
+        }
+    }
+    jobs_.push_back(std::move(job));
+    return static_cast<Handle>(jobs_.size() - 1);
+}
+
+void ShaderCompiler::poll() {
+    for (auto &job: jobs_) {
+        if (!job.pending) {
+            continue;
+        }
+        if (isParallel()) {
+            GLint completed = GL_FALSE;
+            glGetProgramiv(job.program, GL_COMPLETION_STATUS_KHR, &completed);
+            if (completed != GL_TRUE) {
+                continue;
+            }
+        }
+        complete(job);
+    }
+}
+
+void ShaderCompiler::finish() {
+    for (auto &job: jobs_) {
+        if (job.pending) {
+            complete(job);
+        }
+    }
+}
+
+bool ShaderCompiler::isPending(Handle handle) const {
+    return handle >= 0 && handle < static_cast<Handle>(jobs_.size()) && jobs_[handle].pending;
+}
+
+std::unique_ptr<Shader> ShaderCompiler::take(Handle handle) {
+    if (handle < 0 || handle >= static_cast<Handle>(jobs_.size())) {
+        return nullptr;
+    }
+    return std::move(jobs_[handle].shader);
+}
+
+void ShaderCompiler::complete(Job &job) {
+    job.shader.reset(Shader::finishProgram(job.program, job.sources, cache_));
+    job.program = 0;
+    job.pending = false;
+    job.sources.clear();
+    pendingCount_--;
+}
@@ -0,0 +1,95 @@
+#ifndef ANDROIDGLINVESTIGATIONS_SHADERCOMPILER_H
+#define ANDROIDGLINVESTIGATIONS_SHADERCOMPILER_H
+
+#include <GLES3/gl31.h>
+#include <GLES2/gl2ext.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Platform.h"
+#include "ProgramCache.h"
+#include "Shader.h"
+
+/*!
+ * Compiles programs without stalling the render thread. @a submit starts compiling and linking
+ * and returns a handle right away; @a poll picks up the programs the driver has finished, which
+ * then can be taken as Shaders.
+ *
+ * With GL_KHR_parallel_shader_compile the driver compiles on its own threads and @a poll only
+ * collects programs reporting GL_COMPLETION_STATUS_KHR, so it never blocks. Without it the
+ * status query of @a poll is where the driver compiles, so submit everything early and poll late.
+ * Cached program binaries are ready as soon as they're submitted.
+ */
+class ShaderCompiler {
+public:
+    using Handle = int;
+
+    static constexpr Handle kInvalidHandle = -1;
+
+    /*!
+     * Looks for GL_KHR_parallel_shader_compile and lets the driver pick its thread count. Needs a
+     * current context.
+     * @param cache consulted before compiling and filled with what got compiled, may be nullptr
+     */
+    void init(ProgramCache *cache);
+
+    /*!
+     * @return true if the driver compiles in the background
+     */
+    bool isParallel() const { return glMaxShaderCompilerThreadsKHR_ != nullptr; }
+
+    Handle submit(const std::string &vertexSource, const std::string &fragmentSource);
+
+    Handle submit(const std::string &computeSource);
+
+    /*!
+     * @return the handle, kInvalidHandle if an asset can't be read
+     */
+    Handle submit(AssetProvider &assets, const std::string &vertexPath,
+                  const std::string &fragmentPath);
+
+    Handle submit(AssetProvider &assets, const std::string &computePath);
+
+    /*!
+     * Finishes the programs the driver is done with
+     */
+    void poll();
+
+    /*!
+     * Waits for every submitted program
+     */
+    void finish();
+
+    /*!
+     * @return true until the program of @a handle either linked or failed
+     */
+    bool isPending(Handle handle) const;
+
+    /*!
+     * Hands over a ready program, once
+     * @return the shader, nullptr while it's pending, if it failed or was taken already
+     */
+    std::unique_ptr<Shader> take(Handle handle);
+
+    size_t getPendingCount() const { return pendingCount_; }
+
+private:
+    struct Job {
+        std::vector<std::string> sources;
+        GLuint program = 0;
+        bool pending = false;
+        std::unique_ptr<Shader> shader;
+    };
+
+    Handle submitProgram(const std::vector<GLenum> &types, std::vector<std::string> sources);
+
+    void complete(Job &job);
+
+    ProgramCache *cache_ = nullptr;
+    PFNGLMAXSHADERCOMPILERTHREADSKHRPROC glMaxShaderCompilerThreadsKHR_ = nullptr;
+    std::vector<Job> jobs_;
+    size_t pendingCount_ = 0;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_SHADERCOMPILER_H
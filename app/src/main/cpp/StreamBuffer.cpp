@@ -0,0 +1,98 @@
+#include "StreamBuffer.h"
+
+#include <algorithm>
+
+#include "AndroidOut.h"
+
+StreamBuffer::~StreamBuffer() {
+    for (auto &fence: fences_) {
+        if (fence) {
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+    if (buffer_) {
+        glDeleteBuffers(1, &buffer_);
+        buffer_ = 0;
+    }
+}
+
+void StreamBuffer::init(GLsizeiptr regionSize) {
+    GLint uniformAlignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+    if (uniformAlignment > 0) {
+        uniformAlignment_ = uniformAlignment;
+    }
+    GLint storageAlignment = 0;
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storageAlignment);
+    if (storageAlignment > 0) {
+        storageAlignment_ = storageAlignment;
+    }
+    // regions start aligned for anything allocated from them, both alignments are powers of two
+    GLsizeiptr regionAlignment = std::max(uniformAlignment_, storageAlignment_);
+    regionSize_ = (regionSize + regionAlignment - 1) / regionAlignment * regionAlignment;
+
+    glGenBuffers(1, &buffer_);
+    // GL_COPY_WRITE_BUFFER is bound only to get at the buffer, it doesn't affect any draw
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer_);
+    glBufferData(GL_COPY_WRITE_BUFFER, regionSize_ * kRegionCount, nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void StreamBuffer::beginFrame() {
+    region_ = (region_ + 1) % kRegionCount;
+    if (auto &fence = fences_[region_]) {
+        if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+            stallCount_++;
+            while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000)
+                   == GL_TIMEOUT_EXPIRED) {}
+        }
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+    // the fence says the GPU is done with the region, so there's nothing to synchronize with
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer_);
+    mapped_ = static_cast<uint8_t *>(glMapBufferRange(
+            GL_COPY_WRITE_BUFFER, region_ * regionSize_, regionSize_,
+            GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT
+            | GL_MAP_FLUSH_EXPLICIT_BIT));
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    if (!mapped_) {
+        aout << "[ERROR] Failed to map the stream buffer" << std::endl;
+    }
+    used_ = 0;
+}
+
+StreamBuffer::Allocation StreamBuffer::allocate(GLsizeiptr size, GLsizeiptr alignment) {
+    GLsizeiptr offset = (used_ + alignment - 1) & ~(alignment - 1);
+    if (!mapped_ || offset + size > regionSize_) {
+        if (mapped_ && !overflowReported_) {
+            aout << "[ERROR] Stream buffer region of " << regionSize_ << " bytes is full"
+                 << std::endl;
+            overflowReported_ = true;
+        }
+        return {};
+    }
+    used_ = offset + size;
+    return {region_ * regionSize_ + offset, mapped_ + offset};
+}
+
+void StreamBuffer::unmap() {
+    if (!mapped_) {
+        return;
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer_);
+    if (used_ > 0) {
+        glFlushMappedBufferRange(GL_COPY_WRITE_BUFFER, 0, used_);
+    }
+    glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    mapped_ = nullptr;
+    peakUsage_ = std::max(peakUsage_, used_);
+}
+
+void StreamBuffer::endFrame() {
+    unmap();
+    fences_[region_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
@@ -0,0 +1,126 @@
+#ifndef ANDROIDGLINVESTIGATIONS_STREAMBUFFER_H
+#define ANDROIDGLINVESTIGATIONS_STREAMBUFFER_H
+
+#include <GLES3/gl31.h>
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+/*!
+ * Streams per-frame data (uniform blocks, dynamic vertices) through one buffer split into
+ * kRegionCount regions, one per frame in flight. A frame maps its region once, unsynchronized,
+ * and sub-allocates from it; the region isn't reused before the fence of the frame that last
+ * wrote it has signaled, so nothing the GPU still reads gets overwritten.
+ *
+ * A frame goes
+ *
+ *     beginFrame()   waits for the region's fence and maps it
+ *     allocate()...  hands out offsets into the buffer and pointers to write at
+ *     unmap()        flushes what was written, before the first draw reading it
+ *     endFrame()     fences the region after the frame's last command reading it
+ *
+ * Allocations are only valid between beginFrame and unmap, GLES can't draw from a mapped buffer.
+ */
+class StreamBuffer {
+public:
+    static constexpr int kRegionCount = 3;
+
+    struct Allocation {
+        /*!
+         * Offset into getBuffer(), for glBindBufferRange or a vertex attribute pointer
+         */
+        GLintptr offset = 0;
+        /*!
+         * Where to write the data, nullptr if the region is full
+         */
+        void *data = nullptr;
+
+        explicit operator bool() const { return data != nullptr; }
+    };
+
+    StreamBuffer() = default;
+
+    ~StreamBuffer();
+
+    StreamBuffer(const StreamBuffer &) = delete;
+
+    StreamBuffer &operator=(const StreamBuffer &) = delete;
+
+    /*!
+     * Creates the buffer, kRegionCount regions of @a regionSize bytes. Needs a current context.
+     */
+    void init(GLsizeiptr regionSize);
+
+    void beginFrame();
+
+    /*!
+     * @param alignment a power of two
+     * @return the allocation, empty if it doesn't fit what's left of the region
+     */
+    Allocation allocate(GLsizeiptr size, GLsizeiptr alignment);
+
+    /*!
+     * Allocates at GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT and copies @a value there
+     * @return the allocation, empty if it doesn't fit
+     */
+    template<typename T>
+    Allocation writeUniform(const T &value) {
+        return write(&value, sizeof(T), uniformAlignment_);
+    }
+
+    /*!
+     * Allocates at @a alignment and copies @a size bytes of @a data there
+     * @return the allocation, empty if it doesn't fit
+     */
+    Allocation write(const void *data, GLsizeiptr size, GLsizeiptr alignment) {
+        auto allocation = allocate(size, alignment);
+        if (allocation && size > 0) {
+            std::memcpy(allocation.data, data, size);
+        }
+        return allocation;
+    }
+
+    /*!
+     * @return GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, for glBindBufferRange on GL_UNIFORM_BUFFER
+     */
+    GLsizeiptr getUniformAlignment() const { return uniformAlignment_; }
+
+    /*!
+     * @return GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, for glBindBufferRange on
+     * GL_SHADER_STORAGE_BUFFER
+     */
+    GLsizeiptr getStorageAlignment() const { return storageAlignment_; }
+
+    void unmap();
+
+    void endFrame();
+
+    GLuint getBuffer() const { return buffer_; }
+
+    GLsizeiptr getRegionSize() const { return regionSize_; }
+
+    /*!
+     * @return the most bytes a frame allocated so far
+     */
+    GLsizeiptr getPeakUsage() const { return peakUsage_; }
+
+    /*!
+     * @return how often beginFrame had to wait for the GPU to release a region
+     */
+    size_t getStallCount() const { return stallCount_; }
+
+private:
+    GLuint buffer_ = 0;
+    GLsizeiptr regionSize_ = 0;
+    GLsizeiptr uniformAlignment_ = 256;
+    GLsizeiptr storageAlignment_ = 256;
+    std::array<GLsync, kRegionCount> fences_{};
+    int region_ = 0;
+    uint8_t *mapped_ = nullptr;
+    GLsizeiptr used_ = 0;
+    GLsizeiptr peakUsage_ = 0;
+    size_t stallCount_ = 0;
+    bool overflowReported_ = false;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_STREAMBUFFER_H
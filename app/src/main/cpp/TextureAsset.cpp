@@ -1,46 +1,47 @@
-#include <android/imagedecoder.h>
 #include "TextureAsset.h"
 #include "AndroidOut.h"
+#include "GLStateCache.h"
 #include "Utility.h"
 
-std::shared_ptr<TextureAsset>
-TextureAsset::loadAsset(AAssetManager *assetManager, const std::string &assetPath) {
-    // Get the image from asset manager
-    auto pAndroidRobotPng = AAssetManager_open(
-            assetManager,
-            assetPath.c_str(),
-            AASSET_MODE_BUFFER);
-
-    // Make a decoder to turn it into a texture
-    AImageDecoder *pAndroidDecoder = nullptr;
-    auto result = AImageDecoder_createFromAAsset(pAndroidRobotPng, &pAndroidDecoder);
-    assert(result == ANDROID_IMAGE_DECODER_SUCCESS);
-
-    // make sure we get 8 bits per channel out. RGBA order.
-    AImageDecoder_setAndroidBitmapFormat(pAndroidDecoder, ANDROID_BITMAP_FORMAT_RGBA_8888);
+#ifdef __ANDROID__
+#include <android/imagedecoder.h>
+#else
+// The desktop build decodes with the stb_image that ships with assimp
+#define STB_IMAGE_STATIC
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb/stb_image.h>
+#endif
 
-    // Get the image header, to help set everything up
-    const AImageDecoderHeaderInfo *pAndroidHeader = nullptr;
-    pAndroidHeader = AImageDecoder_getHeaderInfo(pAndroidDecoder);
+std::shared_ptr<TextureAsset>
+TextureAsset::loadAsset(AssetProvider &assets, const std::string &assetPath) {
+    Image image;
+    if (!decodeAsset(assets, assetPath, image)) {
+        return nullptr;
+    }
+    return create(image);
+}
 
-    // important metrics for sending to GL
-    auto width = AImageDecoderHeaderInfo_getWidth(pAndroidHeader);
-    auto height = AImageDecoderHeaderInfo_getHeight(pAndroidHeader);
-    auto stride = AImageDecoder_getMinimumStride(pAndroidDecoder);
+bool TextureAsset::decodeAsset(AssetProvider &assets, const std::string &assetPath,
+                               Image &outImage) {
+    // Get the image from the asset provider
+    std::vector<uint8_t> encoded;
+    if (!assets.readAsset(assetPath, encoded)) {
+        return false;
+    }
 
     // Get the bitmap data of the image
-    auto upAndroidImageData = std::make_unique<std::vector<uint8_t>>(height * stride);
-    auto decodeResult = AImageDecoder_decodeImage(
-            pAndroidDecoder,
-            upAndroidImageData->data(),
-            stride,
-            upAndroidImageData->size());
-    assert(decodeResult == ANDROID_IMAGE_DECODER_SUCCESS);
+    if (!decodeImage(encoded, outImage.pixels, outImage.width, outImage.height)) {
+        aout << "[ERROR] Failed to decode " << assetPath << std::endl;
+        return false;
+    }
+    return true;
+}
 
+std::shared_ptr<TextureAsset> TextureAsset::create(const Image &image) {
     // Get an opengl texture
     GLuint textureId;
     glGenTextures(1, &textureId);
-    glBindTexture(GL_TEXTURE_2D, textureId);
+    glState.bindTexture(0, GL_TEXTURE_2D, textureId);
 
     // Clamp to the edge, you'll get odd results alpha blending if you don't
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
@@ -54,27 +55,82 @@ TextureAsset::loadAsset(AAssetManager *assetManager, const std::string &assetPat
             GL_TEXTURE_2D, // target
             0, // mip level
             GL_RGBA, // internal format, often advisable to use BGR
-            width, // width of the texture
-            height, // height of the texture
+            image.width, // width of the texture
+            image.height, // height of the texture
             0, // border (always 0)
             GL_RGBA, // format
             GL_UNSIGNED_BYTE, // type
-            upAndroidImageData->data() // Data to upload
+            image.pixels.data() // Data to upload
     );
 
     // generate mip levels. Not really needed for 2D, but good to do
     glGenerateMipmap(GL_TEXTURE_2D);
 
-    // cleanup helpers
-    AImageDecoder_delete(pAndroidDecoder);
-    AAsset_close(pAndroidRobotPng);
-
     // Create a shared pointer so it can be cleaned up easily/automatically
     return std::shared_ptr<TextureAsset>(new TextureAsset(textureId));
 }
 
+#ifdef __ANDROID__
+bool TextureAsset::decodeImage(
+        const std::vector<uint8_t> &encoded,
+        std::vector<uint8_t> &outPixels,
+        int32_t &outWidth,
+        int32_t &outHeight) {
+    // Make a decoder to turn it into a texture
+    AImageDecoder *pAndroidDecoder = nullptr;
+    auto result = AImageDecoder_createFromBuffer(encoded.data(), encoded.size(), &pAndroidDecoder);
+    if (result != ANDROID_IMAGE_DECODER_SUCCESS) {
+        return false;
+    }
+
+    // make sure we get 8 bits per channel out. RGBA order.
+    AImageDecoder_setAndroidBitmapFormat(pAndroidDecoder, ANDROID_BITMAP_FORMAT_RGBA_8888);
+
+    // Get the image header, to help set everything up
+    const AImageDecoderHeaderInfo *pAndroidHeader = nullptr;
+    pAndroidHeader = AImageDecoder_getHeaderInfo(pAndroidDecoder);
+
+    // important metrics for sending to GL
+    outWidth = AImageDecoderHeaderInfo_getWidth(pAndroidHeader);
+    outHeight = AImageDecoderHeaderInfo_getHeight(pAndroidHeader);
+    auto stride = AImageDecoder_getMinimumStride(pAndroidDecoder);
+
+    outPixels.resize(outHeight * stride);
+    auto decodeResult = AImageDecoder_decodeImage(
+            pAndroidDecoder,
+            outPixels.data(),
+            stride,
+            outPixels.size());
+
+    // cleanup helpers
+    AImageDecoder_delete(pAndroidDecoder);
+    return decodeResult == ANDROID_IMAGE_DECODER_SUCCESS;
+}
+#else
+bool TextureAsset::decodeImage(
+        const std::vector<uint8_t> &encoded,
+        std::vector<uint8_t> &outPixels,
+        int32_t &outWidth,
+        int32_t &outHeight) {
+    int channels = 0;
+    stbi_uc *pixels = stbi_load_from_memory(
+            encoded.data(),
+            static_cast<int>(encoded.size()),
+            &outWidth,
+            &outHeight,
+            &channels,
+            STBI_rgb_alpha);
+    if (!pixels) {
+        return false;
+    }
+    outPixels.assign(pixels, pixels + outWidth * outHeight * 4);
+    stbi_image_free(pixels);
+    return true;
+}
+#endif
+
 TextureAsset::~TextureAsset() {
     // return texture resources
-    glDeleteTextures(1, &textureID_);
+    glState.deleteTextures(1, &textureID_);
     textureID_ = 0;
-}
\ No newline at end of file
+}
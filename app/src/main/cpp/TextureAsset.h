@@ -2,21 +2,43 @@
 #define ANDROIDGLINVESTIGATIONS_TEXTUREASSET_H
 
 #include <memory>
-#include <android/asset_manager.h>
 #include <GLES3/gl31.h>
 #include <string>
 #include <vector>
 
+#include "Platform.h"
+
 class TextureAsset {
 public:
+    /*!
+     * Tightly packed RGBA8 pixels, the first row is the top of the image
+     */
+    struct Image {
+        std::vector<uint8_t> pixels;
+        int32_t width = 0;
+        int32_t height = 0;
+    };
+
     /*!
      * Loads a texture asset from the assets/ directory
-     * @param assetManager Asset manager to use
+     * @param assets Asset provider to use
      * @param assetPath The path to the asset
-     * @return a shared pointer to a texture asset, resources will be reclaimed when it's cleaned up
+     * @return a shared pointer to a texture asset, resources will be reclaimed when it's cleaned up.
+     *     nullptr if the asset can't be read or decoded
      */
     static std::shared_ptr<TextureAsset>
-    loadAsset(AAssetManager *assetManager, const std::string &assetPath);
+    loadAsset(AssetProvider &assets, const std::string &assetPath);
+
+    /*!
+     * The part of @a loadAsset that doesn't need GL, so it can run on any thread
+     * @return false if the asset can't be read or decoded
+     */
+    static bool decodeAsset(AssetProvider &assets, const std::string &assetPath, Image &outImage);
+
+    /*!
+     * The part of @a loadAsset that does need GL: uploads @a image with a full mip chain
+     */
+    static std::shared_ptr<TextureAsset> create(const Image &image);
 
     ~TextureAsset();
 
@@ -26,6 +48,16 @@ public:
     constexpr GLuint getTextureID() const { return textureID_; }
 
 private:
+    /*!
+     * Decodes an encoded image (png, jpg, ...) into tightly packed RGBA8 pixels
+     * @return false if the image can't be decoded
+     */
+    static bool decodeImage(
+            const std::vector<uint8_t> &encoded,
+            std::vector<uint8_t> &outPixels,
+            int32_t &outWidth,
+            int32_t &outHeight);
+
     inline TextureAsset(GLuint textureId) : textureID_(textureId) {}
 
     GLuint textureID_;
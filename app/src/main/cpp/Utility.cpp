@@ -2,6 +2,7 @@
 #include "AndroidOut.h"
 
 #include <GLES3/gl3.h>
+#include <cstring>
 
 #define CHECK_ERROR(e) case e: aout << "GL Error: "#e << std::endl; break;
 
@@ -26,6 +27,18 @@ bool Utility::checkAndLogGlError(bool alwaysLog) {
     }
 }
 
+bool Utility::hasGlExtension(const char *extension) {
+    GLint extensionCount = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+    for (GLint i = 0; i < extensionCount; i++) {
+        auto name = reinterpret_cast<const char *>(glGetStringi(GL_EXTENSIONS, i));
+        if (name && strcmp(name, extension) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
 float *
 Utility::buildOrthographicMatrix(float *outMatrix, float halfHeight, float aspect, float near,
                                  float far) {
@@ -9,6 +9,12 @@ public:
 
     static inline void assertGlError() { assert(checkAndLogGlError()); }
 
+    /*!
+     * @param extension the name of the extension, e.g. "GL_EXT_disjoint_timer_query"
+     * @return true if the current GL context exposes @a extension
+     */
+    static bool hasGlExtension(const char *extension);
+
     /**
      * Generates an orthographic projection matrix given the half height, aspect ratio, near, and far
      * planes
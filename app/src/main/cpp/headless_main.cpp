@@ -0,0 +1,166 @@
+#include <GLES3/gl3.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <glm/gtc/matrix_transform.hpp>
+#include <memory>
+#include <vector>
+
+#include "AndroidOut.h"
+#include "GLStateCache.h"
+#include "HeadlessPlatform.h"
+#include "Renderer.h"
+
+/*!
+ * Desktop entry point. Renders a fixed number of frames into an offscreen pbuffer and reports the
+ * frame times, so the render path can be benchmarked without a device.
+ *
+ * usage: androidexample_headless [--assets dir] [--frames n] [--width w] [--height h]
+ *                                [--frametimes file.csv] [--stats file.csv] [--validate-hzb 1]
+ *                                [--cache-dir dir] [--instances n] [--animate 1] [--meshlets 0|1]
+ *                                [--prepass 1]
+ *
+ * --instances places every model n x n times on a grid going away from the camera, to exercise
+ * instanced drawing. --animate spins the first row of the grid, the other rows stay static.
+ * --meshlets 0 draws the visible meshes whole instead of culling their meshlets. --prepass 1 renders
+ * depth alone before shading, compare the frame and pass times with and without it.
+ */
+int main(int argc, char **argv) {
+    std::string assetDir = ANDROIDEXAMPLE_ASSET_DIR;
+    std::string frameTimesPath;
+    std::string statsPath;
+    std::string cacheDir;
+    bool validateHZB = false;
+    int instanceGrid = 0;
+    bool animate = false;
+    bool meshlets = true;
+    bool depthPrepass = false;
+    int frames = 100;
+    EGLint width = 1280;
+    EGLint height = 720;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "--assets")) {
+            assetDir = argv[i + 1];
+        } else if (!strcmp(argv[i], "--frames")) {
+            frames = atoi(argv[i + 1]);
+        } else if (!strcmp(argv[i], "--width")) {
+            width = atoi(argv[i + 1]);
+        } else if (!strcmp(argv[i], "--height")) {
+            height = atoi(argv[i + 1]);
+        } else if (!strcmp(argv[i], "--frametimes")) {
+            frameTimesPath = argv[i + 1];
+        } else if (!strcmp(argv[i], "--stats")) {
+            statsPath = argv[i + 1];
+        } else if (!strcmp(argv[i], "--cache-dir")) {
+            cacheDir = argv[i + 1];
+        } else if (!strcmp(argv[i], "--validate-hzb")) {
+            validateHZB = atoi(argv[i + 1]) != 0;
+        } else if (!strcmp(argv[i], "--instances")) {
+            instanceGrid = atoi(argv[i + 1]);
+        } else if (!strcmp(argv[i], "--animate")) {
+            animate = atoi(argv[i + 1]) != 0;
+        } else if (!strcmp(argv[i], "--meshlets")) {
+            meshlets = atoi(argv[i + 1]) != 0;
+        } else if (!strcmp(argv[i], "--prepass")) {
+            depthPrepass = atoi(argv[i + 1]) != 0;
+        } else {
+            aout << "Unknown argument " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+
+    Renderer renderer(std::make_unique<HeadlessPlatform>(assetDir, width, height, cacheDir));
+    renderer.setMeshletCulling(meshlets);
+    renderer.setDepthPrepass(depthPrepass);
+    if (validateHZB && !renderer.validateHZB()) {
+        return 1;
+    }
+    // one node per row of the grid, so animating a row moves its instances together
+    std::vector<uint32_t> rowNodes;
+    if (instanceGrid > 0) {
+        constexpr float kInstanceSpacing = 25.f;
+        auto &scene = renderer.getScene();
+        uint32_t root = scene.AddNode(FSceneGraph::kNoParent);
+        std::vector<uint32_t> instanceNodes;
+        for (int z = 0; z < instanceGrid; z++) {
+            uint32_t row = scene.AddNode(root, glm::vec3(0.f, 0.f, -z * kInstanceSpacing));
+            rowNodes.push_back(row);
+            for (int x = 0; x < instanceGrid; x++) {
+                float offset = (x - (instanceGrid - 1) * 0.5f) * kInstanceSpacing;
+                instanceNodes.push_back(scene.AddNode(int32_t(row), glm::vec3(offset, 0.f, 0.f)));
+            }
+        }
+        renderer.setModelInstances(std::move(instanceNodes));
+    }
+    // time the steady state, not the frames waiting for the compiler or the assets
+    renderer.finishLoading();
+
+    std::vector<double> frameTimes;
+    frameTimes.reserve(frames);
+    for (int i = 0; i < frames; i++) {
+        auto start = std::chrono::steady_clock::now();
+        renderer.handleInput();
+        if (animate && !rowNodes.empty()) {
+            renderer.getScene().SetRotation(
+                    rowNodes[0], glm::angleAxis(glm::radians(float(i)), glm::vec3(0.f, 1.f, 0.f)));
+        }
+        renderer.render();
+        // a pbuffer swap doesn't wait for the GPU, so finish here to time the whole frame
+        glFinish();
+        auto end = std::chrono::steady_clock::now();
+        frameTimes.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+    }
+
+    if (frameTimes.empty()) {
+        return 0;
+    }
+
+    double total = 0.0;
+    for (auto frameTime: frameTimes) {
+        total += frameTime;
+    }
+    auto [minTime, maxTime] = std::minmax_element(frameTimes.begin(), frameTimes.end());
+    aout << frames << " frames at " << width << "x" << height << ": avg "
+         << total / frameTimes.size() << " ms, min " << *minTime << " ms, max " << *maxTime
+         << " ms" << std::endl;
+
+    for (const auto &zone: renderer.getProfiler().getStats()) {
+        aout << zone.name << ": cpu avg " << zone.cpu.avg << " ms, p95 " << zone.cpu.p95
+             << " ms; gpu avg " << zone.gpu.avg << " ms, p95 " << zone.gpu.p95 << " ms"
+             << std::endl;
+    }
+    const auto &renderTargets = renderer.getRenderTargets();
+    aout << "Render targets: " << renderTargets.getLiveCount() << " live, "
+         << renderTargets.getLiveBytes() / 1024 << " KiB, peak "
+         << renderTargets.getPeakBytes() / 1024 << " KiB" << std::endl;
+    const auto &stream = renderer.getStream();
+    aout << "Stream buffer: peak " << stream.getPeakUsage() << " of " << stream.getRegionSize()
+         << " bytes per frame, " << stream.getStallCount() << " stalls" << std::endl;
+    const auto &triangles = renderer.getTriangleStats();
+    aout << "Triangles last frame: " << triangles.submitted << " submitted at their LOD, "
+         << triangles.fullDetail << " at full detail";
+    if (meshlets) {
+        aout << ", " << renderer.readMeshletTriangleCount() << " after meshlet culling";
+    }
+    aout << std::endl;
+    const auto &scene = renderer.getScene();
+    aout << "Scene graph: " << scene.Size() << " nodes, " << scene.GetLastUpdateCount()
+         << " updated last frame" << std::endl;
+    aout << "GL state calls last frame: " << glState.getIssuedCalls() << " issued, "
+         << glState.getElidedCalls() << " elided" << std::endl;
+    if (!statsPath.empty()) {
+        renderer.getProfiler().dumpStats(statsPath);
+    }
+
+    if (!frameTimesPath.empty()) {
+        std::ofstream out(frameTimesPath);
+        out << "frame,ms\n";
+        for (size_t i = 0; i < frameTimes.size(); i++) {
+            out << i << "," << frameTimes[i] << "\n";
+        }
+    }
+    return 0;
+}
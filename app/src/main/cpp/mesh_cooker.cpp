@@ -0,0 +1,60 @@
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "AndroidOut.h"
+#include "JobSystem.h"
+#include "Model.h"
+
+/*!
+ * Host tool that imports a model with assimp and writes it as a cooked model, the GPU-ready blob
+ * FModel::ImportAsset maps instead of importing. See CookedModel.h for the format.
+ *
+ * usage: androidexample_mesh_cooker input.obj output.mesh
+ *
+ * Put the output next to the input in the assets, with the same name and a .mesh extension. The
+ * cook_models target does that for every OBJ in app/src/main/assets.
+ */
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        aout << "usage: " << argv[0] << " input.obj output.mesh" << std::endl;
+        return 1;
+    }
+    std::string inputPath = argv[1];
+    std::string outputPath = argv[2];
+
+    jobSystem.start(std::max(std::thread::hardware_concurrency(), 2u) - 1);
+
+    FModel model;
+    model.LoadFile(inputPath);
+    if (model.GetMeshCount() == 0) {
+        aout << "[ERROR] " << inputPath << " has no triangle meshes" << std::endl;
+        return 1;
+    }
+
+    std::vector<uint8_t> blob;
+    model.Cook(blob);
+
+    // written aside and renamed, so a failed write never leaves a truncated blob to be mapped
+    std::string temporaryPath = outputPath + ".tmp";
+    {
+        std::ofstream out(temporaryPath, std::ios::binary | std::ios::trunc);
+        if (!out.write(reinterpret_cast<const char *>(blob.data()), blob.size())) {
+            aout << "[ERROR] Failed to write " << temporaryPath << std::endl;
+            return 1;
+        }
+    }
+    if (std::rename(temporaryPath.c_str(), outputPath.c_str()) != 0) {
+        aout << "[ERROR] Failed to rename " << temporaryPath << " to " << outputPath << std::endl;
+        std::remove(temporaryPath.c_str());
+        return 1;
+    }
+
+    aout << "Cooked " << inputPath << ": " << model.GetMeshCount() << " meshes, "
+         << model.GetMaterialTextures().size() << " materials, " << blob.size() / 1024
+         << " KiB" << std::endl;
+    return 0;
+}